@@ -0,0 +1,131 @@
+// $Id$
+/// @file: BandwidthLimiter.h
+
+#ifndef EventFilter_SMProxyServer_BandwidthLimiter_h
+#define EventFilter_SMProxyServer_BandwidthLimiter_h
+
+#include "EventFilter/SMProxyServer/interface/TokenBucket.h"
+
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include <map>
+#include <string>
+
+
+namespace smproxy {
+
+  /**
+   * Caps the bandwidth pulled from the SMs by all event retrievers.
+   *
+   * Each retriever is a flow drawing from a global token bucket and
+   * from a token bucket per SM. The size of an event is only known
+   * once it has been retrieved. Thus, a flow waits until the buckets
+   * are out of debt and reserves the size of its previous event.
+   * Once the event has been retrieved, the reservation is corrected
+   * for its actual size.
+   *
+   * Flows waiting at the same time are served in the order of their
+   * virtual time, which advances by the bytes retrieved divided by
+   * the weight of the flow. Thus, the bandwidth is shared in the ratio
+   * of the weights while the cap is reached.
+   *
+   * $Author$
+   * $Revision$
+   * $Date$
+   */
+
+  class BandwidthLimiter
+  {
+  public:
+
+    typedef size_t FlowID;
+
+    BandwidthLimiter();
+
+    /**
+     * Set the caps in bytes per second. 0 means unlimited.
+     */
+    void setLimits(const double bytesPerSecond, const double bytesPerSecondPerSM);
+
+    /**
+     * Return the cap in bytes per second. 0 means unlimited.
+     */
+    double limit() const;
+
+    /**
+     * Return the cap per SM in bytes per second. 0 means unlimited.
+     */
+    double limitPerSM() const;
+
+    /**
+     * Add a flow with the given weight
+     */
+    FlowID addFlow(const double weight);
+
+    /**
+     * Remove the given flow
+     */
+    void removeFlow(const FlowID&);
+
+    /**
+     * Wait until the given flow may retrieve data from the SM.
+     * This is an interruption point.
+     */
+    void acquire(const FlowID&, const std::string& sourceURL);
+
+    /**
+     * Charge the given flow for the bytes retrieved from the SM
+     */
+    void charge(const FlowID&, const std::string& sourceURL, const size_t bytes);
+
+
+  private:
+
+    struct Flow
+    {
+      double weight;
+      double virtualTime;
+      bool waiting;
+      size_t expectedBytes;
+      size_t reservedBytes;
+      stor::utils::TimePoint_t lastCharge;
+      std::string sourceURL;
+    };
+    typedef std::map<FlowID, Flow> Flows;
+
+    typedef std::map<std::string, TokenBucket> SMBuckets;
+
+    TokenBucket& getSMBucket(const std::string& sourceURL);
+    void consume(Flow&, const std::string& sourceURL, const double bytes);
+    bool unlimited() const;
+    bool ready(const Flow&, const stor::utils::TimePoint_t& now, stor::utils::TimePoint_t& readyTime);
+    bool hasPrecedence(const Flows::const_iterator&, const stor::utils::TimePoint_t& now);
+    bool minWaitingVirtualTime(double&) const;
+
+    double limit_;
+    double limitPerSM_;
+    TokenBucket globalBucket_;
+    SMBuckets smBuckets_;
+
+    Flows flows_;
+    FlowID nextFlowId_;
+
+    mutable boost::mutex mutex_;
+    boost::condition_variable changed_;
+  };
+
+  typedef boost::shared_ptr<BandwidthLimiter> BandwidthLimiterPtr;
+
+} // namespace smproxy
+
+#endif // EventFilter_SMProxyServer_BandwidthLimiter_h
+
+
+/// emacs configuration
+/// Local Variables: -
+/// mode: c++ -
+/// c-basic-offset: 2 -
+/// indent-tabs-mode: nil -
+/// End: -
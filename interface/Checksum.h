@@ -0,0 +1,51 @@
+// $Id$
+/// @file: Checksum.h
+
+#ifndef EventFilter_SMProxyServer_Checksum_h
+#define EventFilter_SMProxyServer_Checksum_h
+
+#include "IOPool/Streamer/interface/DQMEventMessage.h"
+#include "IOPool/Streamer/interface/EventMessage.h"
+
+#include <stdint.h>
+#include <cstddef>
+
+
+namespace smproxy {
+
+  /**
+   * Verification of the Adler32 checksum which the event and
+   * DQM event headers carry for their payload.
+   *
+   * The checksum is calculated with SSE2 where available, which
+   * processes 16 bytes per step. Otherwise, the scalar calculation
+   * from FWCore is used.
+   *
+   * $Author$
+   * $Revision$
+   * $Date$
+   */
+
+  /**
+   * Return the Adler32 checksum of the given data
+   */
+  uint32_t adler32(const unsigned char* data, const size_t length);
+
+  /**
+   * Return false if the payload does not match the checksum in the
+   * header. Messages without checksum are considered valid.
+   */
+  bool hasValidChecksum(const EventMsgView&);
+  bool hasValidChecksum(const DQMEventMsgView&);
+
+} // namespace smproxy
+
+#endif // EventFilter_SMProxyServer_Checksum_h
+
+
+/// emacs configuration
+/// Local Variables: -
+/// mode: c++ -
+/// c-basic-offset: 2 -
+/// indent-tabs-mode: nil -
+/// End: -
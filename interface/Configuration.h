@@ -15,6 +15,7 @@
 #include "xdata/Boolean.h"
 #include "xdata/Vector.h"
 
+#include "boost/shared_ptr.hpp"
 #include "boost/thread/mutex.hpp"
 
 
@@ -31,9 +32,28 @@ namespace smproxy
     bool allowMissingSM_;
     uint32_t maxConnectionRetries_;
     uint32_t connectTrySleepTime_;
+    uint32_t maxConnectTrySleepTime_;
     uint32_t headerRetryInterval_;
     uint32_t retryInterval_;
     stor::utils::Duration_t sleepTimeIfIdle_;
+    bool routeByTriggerBits_;
+    uint32_t pipelineQueueDepth_;
+    std::string spoolDirectory_;
+    uint32_t spoolSizeMB_;
+    stor::utils::Duration_t spoolReplayWindow_;
+    std::string captureDirectory_;
+    uint32_t captureSizeMB_;
+    typedef std::vector<std::string> OutputModuleLabels;
+    OutputModuleLabels prewarmOutputModules_;
+    bool warmRestart_;
+    stor::utils::Duration_t stopTimeout_;
+    typedef std::vector<std::string> ConsumerPatterns;
+    ConsumerPatterns highPriorityConsumers_;
+    ConsumerPatterns lowPriorityConsumers_;
+    double maxBandwidth_;       // MB/s, 0 means unlimited
+    double maxBandwidthPerSM_;  // MB/s, 0 means unlimited
+    bool verifyChecksums_;
+    uint32_t maxRequestsPerSM_; // 0 means unlimited
 
     // not mapped to infospace params
     uint32_t smpsInstance_;
@@ -59,6 +79,7 @@ namespace smproxy
   struct QueueConfigurationParams
   {
     uint32_t registrationQueueSize_;
+    uint32_t registrationQueueMaxSize_;
     stor::utils::Duration_t monitoringSleepSec_;
   };
 
@@ -77,6 +98,36 @@ namespace smproxy
                                 // are read from the configuration
   };
 
+  /**
+   * Data structure to hold the CPU lists the threads
+   * are pinned to (see ThreadAffinity for the format)
+   */
+  struct ThreadAffinityParams
+  {
+    std::string retrieverCPUs_;   // event and DQM retrievers
+    std::string dataManagerCPUs_; // registration and watch dog threads
+    std::string archiverCPUs_;    // DQM archiver
+    std::string monitoringCPUs_;  // statistics workloop
+  };
+
+  /**
+   * An immutable snapshot of all configuration parameters.
+   * Each update of the local cache from the infospace publishes
+   * a new snapshot with a higher version number.
+   */
+  struct ConfigurationSnapshot
+  {
+    uint32_t version_;
+    struct DataRetrieverParams dataRetrieverParams_;
+    struct stor::EventServingParams eventServeParams_;
+    struct stor::DQMProcessingParams dqmProcessingParams_;
+    struct DQMArchivingParams dqmArchivingParams_;
+    struct QueueConfigurationParams queueConfigParams_;
+    struct AlarmParams alarmParams_;
+    struct ThreadAffinityParams threadAffinityParams_;
+  };
+  typedef boost::shared_ptr<const ConfigurationSnapshot> ConfigurationSnapshotPtr;
+
   /**
    * Class for managing configuration information from the infospace
    * and providing local copies of that information that are updated
@@ -106,13 +157,16 @@ namespace smproxy
     }
 
     /**
-     * Returns a copy of the event retriever parameters. These values
-     * will be current as of the most recent global update of the local
-     * cache from the infospace (see the updateAllParams() method) or
-     * the most recent update of only the event retrieved parameters
-     * (see the updateDataRetrieverParams() method).
+     * Returns the current snapshot of all parameters without locking.
+     * The snapshot never changes. A reader holding on to it can compare
+     * its version with the one of the current snapshot to find out if
+     * the parameters have changed. The SMRegistrationList is also
+     * republished when it is changed while the proxy is running.
+     * The event retriever parameters, which include the list of SMs,
+     * are only handed out with the snapshot to avoid copying them.
      */
-    struct DataRetrieverParams getDataRetrieverParams() const;
+    ConfigurationSnapshotPtr getSnapshot() const
+    { return boost::atomic_load(&snapshot_); }
 
     /**
      * Returns a copy of the DQM processing parameters.  These values
@@ -148,6 +202,13 @@ namespace smproxy
      * cache from the infospace (see the updateAllParams() method).
      */
     struct AlarmParams getAlarmParams() const;
+
+    /**
+     * Returns a copy of the thread affinity parameters.  These values
+     * will be current as of the most recent global update of the local
+     * cache from the infospace (see the updateAllParams() method).
+     */
+    struct ThreadAffinityParams getThreadAffinityParams() const;
     
     /**
      * Updates the local copy of all configuration parameters from
@@ -170,6 +231,7 @@ namespace smproxy
     void setDQMArchivingDefaults();
     void setQueueConfigurationDefaults();
     void setAlarmDefaults();
+    void setThreadAffinityDefaults();
 
     void setupDataRetrieverInfoSpaceParams(xdata::InfoSpace*);
     void setupEventServingInfoSpaceParams(xdata::InfoSpace*);
@@ -177,6 +239,7 @@ namespace smproxy
     void setupDQMArchivingInfoSpaceParams(xdata::InfoSpace*);
     void setupQueueConfigurationInfoSpaceParams(xdata::InfoSpace*);
     void setupAlarmInfoSpaceParams(xdata::InfoSpace* infoSpace);
+    void setupThreadAffinityInfoSpaceParams(xdata::InfoSpace*);
 
     void updateLocalDataRetrieverData();
     void updateLocalEventServingData();
@@ -184,6 +247,9 @@ namespace smproxy
     void updateLocalDQMArchivingData();
     void updateLocalQueueConfigurationData();
     void updateLocalAlarmData();
+    void updateLocalThreadAffinityData();
+
+    void publishSnapshot();
 
     struct DataRetrieverParams dataRetrieverParamCopy_;
     struct stor::EventServingParams eventServeParamCopy_;
@@ -191,16 +257,36 @@ namespace smproxy
     struct DQMArchivingParams dqmArchivingParamCopy_;
     struct QueueConfigurationParams queueConfigParamCopy_;
     struct AlarmParams alarmParamCopy_;
+    struct ThreadAffinityParams threadAffinityParamCopy_;
     
+    // serializes the updates, readers only use the snapshot
     mutable boost::mutex generalMutex_;
+    ConfigurationSnapshotPtr snapshot_;
     
     xdata::Vector<xdata::String> smRegistrationList_;
     xdata::Boolean allowMissingSM_;
     xdata::UnsignedInteger32 maxConnectionRetries_;
     xdata::UnsignedInteger32 connectTrySleepTime_; // seconds
+    xdata::UnsignedInteger32 maxConnectTrySleepTime_; // seconds
     xdata::UnsignedInteger32 headerRetryInterval_; // seconds
     xdata::UnsignedInteger32 retryInterval_; // seconds
     xdata::UnsignedInteger32 sleepTimeIfIdle_;  // milliseconds
+    xdata::Boolean routeByTriggerBits_;
+    xdata::UnsignedInteger32 pipelineQueueDepth_; // events
+    xdata::String spoolDirectory_;
+    xdata::UnsignedInteger32 spoolSizeMB_; // MB per event type
+    xdata::UnsignedInteger32 spoolReplayWindow_; // seconds
+    xdata::String captureDirectory_;
+    xdata::UnsignedInteger32 captureSizeMB_; // MB per event type
+    xdata::Vector<xdata::String> prewarmOutputModules_;
+    xdata::Boolean warmRestart_;
+    xdata::UnsignedInteger32 stopTimeout_; // seconds
+    xdata::Vector<xdata::String> highPriorityConsumers_;
+    xdata::Vector<xdata::String> lowPriorityConsumers_;
+    xdata::Double maxBandwidth_; // MB/s
+    xdata::Double maxBandwidthPerSM_; // MB/s
+    xdata::Boolean verifyChecksums_;
+    xdata::UnsignedInteger32 maxRequestsPerSM_;
 
     xdata::Boolean collateDQM_;
     xdata::Integer readyTimeDQM_;  // seconds
@@ -220,10 +306,16 @@ namespace smproxy
     xdata::String  _DQMconsumerQueuePolicy;
     
     xdata::UnsignedInteger32 registrationQueueSize_;
+    xdata::UnsignedInteger32 registrationQueueMaxSize_;
     xdata::Double monitoringSleepSec_;  // seconds
 
     xdata::Boolean sendAlarms_;
     xdata::Double corruptedEventRate_; // Hz
+
+    xdata::String retrieverCPUs_;
+    xdata::String dataManagerCPUs_;
+    xdata::String archiverCPUs_;
+    xdata::String monitoringCPUs_;
   };
 
   typedef boost::shared_ptr<Configuration> ConfigurationPtr;
@@ -0,0 +1,123 @@
+// $Id$
+/// @file: ConsumerExpiryWheel.h
+
+#ifndef EventFilter_SMProxyServer_ConsumerExpiryWheel_h
+#define EventFilter_SMProxyServer_ConsumerExpiryWheel_h
+
+#include "EventFilter/StorageManager/interface/QueueID.h"
+#include "EventFilter/StorageManager/interface/Utils.h"
+
+#include <stdint.h>
+
+#include <map>
+#include <utility>
+#include <vector>
+
+
+namespace smproxy {
+
+  /**
+   * A hierarchical timer wheel holding the expiry deadlines
+   * of the consumer queues. Expiring the due queues costs
+   * O(expired) instead of a scan over all queues.
+   *
+   * A deadline which is moved later is only updated in place.
+   * The queue is moved to its new slot once its old slot is due.
+   *
+   * The class is not thread-safe. The owner has to take care
+   * of any locking.
+   *
+   * $Author$
+   * $Revision$
+   * $Date$
+   */
+
+  class ConsumerExpiryWheel
+  {
+  public:
+
+    /**
+     * Create a wheel advancing in steps of the given resolution
+     */
+    ConsumerExpiryWheel
+    (
+      const stor::utils::Duration_t& resolution,
+      const stor::utils::TimePoint_t& now = stor::utils::getCurrentTime()
+    );
+
+    /**
+     * Set the expiry deadline of the given queue. An already
+     * scheduled queue gets the new deadline.
+     */
+    void schedule(const stor::QueueID&, const stor::utils::TimePoint_t& deadline);
+
+    /**
+     * Remove the given queue from the wheel
+     */
+    void cancel(const stor::QueueID&);
+
+    /**
+     * Advance the wheel to the given time and append the queues
+     * whose deadline has passed to the QueueIDs. The expired
+     * queues are removed from the wheel.
+     */
+    void expire(const stor::utils::TimePoint_t&, stor::QueueIDs& expired);
+
+    /**
+     * Remove all queues
+     */
+    void clear();
+
+    /**
+     * Return the number of scheduled queues
+     */
+    size_t size() const
+    { return entries_.size(); }
+
+    /**
+     * Return the resolution of the deadlines
+     */
+    const stor::utils::Duration_t& resolution() const
+    { return resolution_; }
+
+
+  private:
+
+    struct Entry
+    {
+      uint64_t deadlineTick;
+      uint64_t slotTick;
+      uint64_t generation;
+    };
+    typedef std::map<stor::QueueID, Entry> Entries;
+
+    uint64_t toTick(const stor::utils::TimePoint_t&, const bool roundUp) const;
+    void insert(Entries::iterator, const uint64_t earliestTick);
+
+    static const size_t SLOT_BITS = 6;
+    static const size_t SLOTS = 1 << SLOT_BITS;
+    static const size_t LEVELS = 4;
+
+    const stor::utils::Duration_t resolution_;
+    const stor::utils::TimePoint_t startTime_;
+    uint64_t currentTick_;
+    uint64_t nextGeneration_;
+    Entries entries_;
+
+    // The slots hold the queue with the generation of its entry.
+    // Entries rescheduled or cancelled leave outdated items behind.
+    typedef std::vector< std::pair<stor::QueueID, uint64_t> > Slot;
+    Slot slots_[LEVELS][SLOTS];
+  };
+
+} // namespace smproxy
+
+#endif // EventFilter_SMProxyServer_ConsumerExpiryWheel_h
+
+
+/// emacs configuration
+/// Local Variables: -
+/// mode: c++ -
+/// c-basic-offset: 2 -
+/// indent-tabs-mode: nil -
+/// End: -
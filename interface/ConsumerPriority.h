@@ -0,0 +1,73 @@
+// $Id$
+/// @file: ConsumerPriority.h
+
+#ifndef EventFilter_SMProxyServer_ConsumerPriority_h
+#define EventFilter_SMProxyServer_ConsumerPriority_h
+
+#include "EventFilter/SMProxyServer/interface/Configuration.h"
+#include "EventFilter/StorageManager/interface/RegistrationInfoBase.h"
+
+#include <ostream>
+
+
+namespace smproxy {
+
+  /**
+   * The priority class of a consumer. Under CPU pressure, the
+   * retrievers of high priority consumers are scheduled first
+   * and low priority consumers lose events first.
+   *
+   * The class is assigned when the consumer registers: consumers
+   * whose name or host contains one of the configured high or low
+   * priority patterns get that class. Otherwise, DQM consumers are
+   * high priority and event consumers normal priority.
+   *
+   * $Author$
+   * $Revision$
+   * $Date$
+   */
+
+  enum ConsumerPriority
+  {
+    HIGH_PRIORITY,
+    NORMAL_PRIORITY,
+    LOW_PRIORITY,
+    PRIORITY_CLASSES
+  };
+
+  /**
+   * Return the priority class of the given consumer
+   */
+  ConsumerPriority getConsumerPriority(const stor::RegPtr, DataRetrieverParams const&);
+
+  /**
+   * Return the weight of the priority class when sharing
+   * the bandwidth from the SMs
+   */
+  double getBandwidthWeight(const ConsumerPriority&);
+
+  /**
+   * Lower the scheduling priority of the calling thread according
+   * to the priority class, relative to the given nice value.
+   * This is a no-op for high priority.
+   */
+  void setThreadPriority(const ConsumerPriority&, const int baseNice);
+
+  /**
+   * Return the nice value of the calling thread
+   */
+  int getThreadNice();
+
+  std::ostream& operator<<(std::ostream&, const ConsumerPriority&);
+
+} // namespace smproxy
+
+#endif // EventFilter_SMProxyServer_ConsumerPriority_h
+
+
+/// emacs configuration
+/// Local Variables: -
+/// mode: c++ -
+/// c-basic-offset: 2 -
+/// indent-tabs-mode: nil -
+/// End: -
@@ -7,6 +7,7 @@
 #include "EventFilter/SMProxyServer/interface/Configuration.h"
 #include "EventFilter/SMProxyServer/interface/DataRetrieverMonitorCollection.h"
 #include "EventFilter/SMProxyServer/interface/EventRetriever.h"
+#include "EventFilter/SMProxyServer/interface/ThreadAffinity.h"
 #include "EventFilter/StorageManager/interface/DQMEventConsumerRegistrationInfo.h"
 #include "EventFilter/StorageManager/interface/DQMEventQueueCollection.h"
 #include "EventFilter/StorageManager/interface/EventConsumerRegistrationInfo.h"
@@ -17,8 +18,12 @@
 #include <boost/scoped_ptr.hpp>
 #include <boost/shared_ptr.hpp>
 #include <boost/thread/thread.hpp>
+#include <boost/unordered_map.hpp>
 
 #include <map>
+#include <string>
+#include <utility>
+#include <vector>
 
 
 namespace smproxy {
@@ -41,16 +46,42 @@ namespace smproxy {
 
     ~DataManager();
 
+    /**
+     * Connect to the SMs and retrieve the INIT messages for the
+     * output modules to be prewarmed. The connections are handed
+     * to the first retriever requesting all events from the module.
+     */
+    void prewarm(ConfigurationSnapshotPtr);
+
     /**
      * Start retrieving data
      */
-    void start(DataRetrieverParams const&);
+    void start(ConfigurationSnapshotPtr);
 
     /**
      * Stop retrieving data
      */
     void stop();
 
+    /**
+     * Stop serving data at the end of a run, but keep the
+     * retrievers and their SM connections for the next run
+     */
+    void pause();
+
+    /**
+     * Return true if the retrievers have been kept from the last run
+     */
+    bool isPaused() const
+    { return paused_; }
+
+    /**
+     * Pin the watch dog thread to the given CPUs. The registration
+     * thread picks up its CPUs from the configuration when started.
+     */
+    void setWatchDogCPUs(const std::string& cpuLists)
+    { watchDogAffinity_.setCPUs(cpuLists); }
+
     /**
      * Get list of data event consumer queueIDs for given event type.
      * Returns false if the event type is not found.
@@ -71,6 +102,20 @@ namespace smproxy {
       stor::QueueIDs&
     ) const;
 
+    /**
+     * Return a fingerprint of the events the consumer requests from the SMs.
+     * The prescale is applied by the EventRetriever for each consumer.
+     * Thus, consumers only differing in their prescale share a retriever.
+     * If routing by trigger bits is enabled, all consumers with a simple
+     * path selection for the same output module share a retriever.
+     * Consumers of different priority classes never share a retriever.
+     */
+    static std::string selectionKey
+    (
+      const stor::EventConsRegPtr,
+      DataRetrieverParams const&
+    );
+
     typedef EventRetriever<stor::DQMEventConsumerRegistrationInfo,
                            stor::DQMEventQueueCollectionPtr> DQMEventRetriever;
 
@@ -78,30 +123,59 @@ namespace smproxy {
 
     void activity();
     void doIt();
+    void adjustRegistrationQueueCapacity(const size_t backlog, QueueConfigurationParams const&);
+    int registrationRank(const stor::RegPtr) const;
+    static bool rankComp(const std::pair<int,stor::RegPtr>&, const std::pair<int,stor::RegPtr>&);
     bool addEventConsumer(stor::RegPtr);
     bool addDQMEventConsumer(stor::RegPtr);
     void watchDog();
     void checkForStaleConsumers();
+    void prewarmConnection(const std::string& outputModuleLabel, const std::string& sourceURL);
 
     StateMachine* stateMachine_;
     stor::RegistrationQueuePtr registrationQueue_;
-    DataRetrieverParams dataRetrieverParams_;
+
+    // The configuration of the current run, shared instead of copied
+    ConfigurationSnapshotPtr configuration_;
+    const DataRetrieverParams& dataRetrieverParams() const
+    { return configuration_->dataRetrieverParams_; }
+
+    bool paused_;
 
     boost::scoped_ptr<boost::thread> thread_;
     boost::scoped_ptr<boost::thread> watchDogThread_;
+    ThreadAffinity watchDogAffinity_;
 
     typedef EventRetriever<stor::EventConsumerRegistrationInfo,
                            EventQueueCollectionPtr> DataEventRetriever;
     typedef boost::shared_ptr<DataEventRetriever> DataEventRetrieverPtr;
-    typedef std::map<stor::EventConsRegPtr, DataEventRetrieverPtr,
-                     stor::utils::ptrComp<stor::EventConsumerRegistrationInfo> > DataEventRetrieverMap;
+
+    void takePrewarmedEventServers
+    (
+      stor::EventConsRegPtr,
+      DataEventRetriever::EventServersByURL&
+    );
+
+    typedef boost::unordered_map<std::string, DataEventRetrieverPtr> DataEventRetrieverMap;
     DataEventRetrieverMap dataEventRetrievers_;
 
+    typedef std::map<std::string, DataEventRetriever::EventServersByURL> PrewarmedEventServers;
+    PrewarmedEventServers prewarmedEventServers_;
+    typedef std::vector<stor::CurlInterface::Content> InitMsgs;
+    InitMsgs prewarmedInitMsgs_;
+    mutable boost::mutex prewarmMutex_;
+
     typedef boost::shared_ptr<DQMEventRetriever> DQMEventRetrieverPtr;
     typedef std::map<stor::DQMEventConsRegPtr, DQMEventRetrieverPtr,
                      stor::utils::ptrComp<stor::DQMEventConsumerRegistrationInfo> > DQMEventRetrieverMap;
     DQMEventRetrieverMap dqmEventRetrievers_;
 
+    // The retriever maps are looked up from the consumer threads while
+    // the registration thread adds retrievers. Only the registration
+    // thread modifies the maps while it runs. Thus, it and the state
+    // transitions, which run while it is stopped, read them unlocked.
+    mutable boost::mutex retrieversMutex_;
+
   };
 
   typedef boost::shared_ptr<DataManager> DataManagerPtr;
@@ -6,6 +6,7 @@
 
 #include "EventFilter/SMProxyServer/interface/Configuration.h"
 #include "EventFilter/SMProxyServer/interface/ConnectionID.h"
+#include "EventFilter/SMProxyServer/interface/ConsumerPriority.h"
 #include "EventFilter/StorageManager/interface/AlarmHandler.h"
 #include "EventFilter/StorageManager/interface/DQMEventConsumerRegistrationInfo.h"
 #include "EventFilter/StorageManager/interface/EventConsumerRegistrationInfo.h"
@@ -36,12 +37,13 @@ namespace smproxy {
   {
   public:
 
-    enum ConnectionStatus { CONNECTED, CONNECTION_FAILED, DISCONNECTED, UNKNOWN };
+    enum ConnectionStatus { CONNECTED, CONNECTION_FAILED, DISCONNECTED, CLOSED, UNKNOWN };
 
     struct EventStats
     {
       stor::MonitoredQuantity::Stats sizeStats; //kB
       stor::MonitoredQuantity::Stats corruptedEventsStats;
+      stor::MonitoredQuantity::Stats discardedEventsStats; //kB
     };
     
     struct SummaryStats
@@ -57,6 +59,22 @@ namespace smproxy {
 
     typedef std::map<std::string, EventStats> ConnectionStats;
 
+    enum PipelineStage { FETCH_STAGE, BUILD_STAGE, ENQUEUE_STAGE, PIPELINE_STAGES };
+
+    struct PipelineStageStats
+    {
+      stor::MonitoredQuantity::Stats occupancyStats; //events waiting in the input queue
+      stor::MonitoredQuantity::Stats stallTimeStats; //seconds
+    };
+    typedef std::vector<PipelineStageStats> PipelineStats;
+
+    struct PriorityClassStats
+    {
+      stor::MonitoredQuantity::Stats servedEventsStats; //events handed to the consumers
+      stor::MonitoredQuantity::Stats shedEventsStats;   //events dropped under load
+    };
+    typedef std::vector<PriorityClassStats> PriorityStats;
+
     struct EventTypePerConnectionStats
     {
       stor::RegPtr regPtr;
@@ -85,6 +103,13 @@ namespace smproxy {
      */
     bool setConnectionStatus(const ConnectionID&, const ConnectionStatus&);
 
+    /**
+     * Mark the given connection as closed by the retriever. Its statistics
+     * are kept for the recent statistics window and dropped afterwards.
+     * Returns false if the ConnectionID is unknown.
+     */
+    bool removeConnection(const ConnectionID&);
+
     /**
      * Put the event type statistics for the given consumer ID into
      * the passed EventTypePerConnectionStats. Return false if the connection ID is not found.
@@ -103,6 +128,57 @@ namespace smproxy {
      */
     bool receivedCorruptedEvent(const ConnectionID&);
 
+    /**
+     * Increment number of corrupted events replayed from a spool.
+     * These are only counted in the totals as they cannot be
+     * attributed to a connection.
+     */
+    void receivedCorruptedSpooledEvent();
+
+    /**
+     * Add the size in Bytes of an event retrieved from the given connection
+     * which could not be delivered as the queues of all consumers were full.
+     * Returns false if the ConnectionID is unknown.
+     */
+    bool addDiscardedSample(const ConnectionID&, const unsigned int& size);
+
+    /**
+     * Add a sample for the given stage of the data event retrieval pipeline:
+     * the number of events waiting in the input queue of the stage and the
+     * time in seconds the stage was stalled on its queues.
+     */
+    void addPipelineStageSample
+    (
+      const PipelineStage&,
+      const size_t& occupancy,
+      const double& stallTime
+    );
+
+    /**
+     * Write the statistics of the data event retrieval pipeline stages
+     * into the given vector, indexed by PipelineStage. The statistics
+     * are summed over all data event retrievers.
+     */
+    void getPipelineStats(PipelineStats&) const;
+
+    /**
+     * Add the number of consumers of the given priority class
+     * an event has been handed to.
+     */
+    void addServedEvents(const ConsumerPriority&, const size_t& consumerCount);
+
+    /**
+     * Count an event dropped for the consumers of the given
+     * priority class because the retriever could not keep up.
+     */
+    void addShedEvent(const ConsumerPriority&);
+
+    /**
+     * Write the statistics for each consumer priority class
+     * into the given vector, indexed by ConsumerPriority.
+     */
+    void getPriorityStats(PriorityStats&) const;
+
     /**
      * Write the data retrieval summary statistics into the given struct.
      */
@@ -123,12 +199,21 @@ namespace smproxy {
      */
     void configureAlarms(AlarmParams const&);
 
+    /**
+     * If set, a reset only clears the statistics of the known
+     * connections instead of forgetting them. This is used
+     * when the retrievers are kept alive for the next run.
+     */
+    void keepConnectionsOnReset(const bool keep)
+    { keepConnectionsOnReset_ = keep; }
+
   private:
     
     struct EventMQ
     {
       stor::MonitoredQuantity size_;       //kB
       stor::MonitoredQuantity corruptedEvents_;
+      stor::MonitoredQuantity discardedEvents_; //kB
 
       EventMQ(const stor::utils::Duration_t& updateInterval);
       void getStats(EventStats&) const;
@@ -137,11 +222,38 @@ namespace smproxy {
     };
     typedef boost::shared_ptr<EventMQ> EventMQPtr;
 
+    struct PipelineStageMQ
+    {
+      stor::MonitoredQuantity occupancy_;
+      stor::MonitoredQuantity stallTime_; //seconds
+
+      PipelineStageMQ(const stor::utils::Duration_t& updateInterval);
+      void getStats(PipelineStageStats&) const;
+      void calculateStatistics();
+      void reset();
+    };
+    typedef boost::shared_ptr<PipelineStageMQ> PipelineStageMQPtr;
+
+    struct PriorityClassMQ
+    {
+      stor::MonitoredQuantity servedEvents_;
+      stor::MonitoredQuantity shedEvents_;
+
+      PriorityClassMQ(const stor::utils::Duration_t& updateInterval);
+      void getStats(PriorityClassStats&) const;
+      void calculateStatistics();
+      void reset();
+    };
+    typedef boost::shared_ptr<PriorityClassMQ> PriorityClassMQPtr;
+
     struct DataRetrieverMQ
     {
       stor::RegPtr regPtr_;
       ConnectionStatus connectionStatus_;
       EventMQPtr eventMQ_;
+      EventMQPtr connectionMQ_;  // shared by all connections to the same SM
+      EventMQPtr eventTypeMQ_;   // shared by all connections of the same event type
+      stor::utils::TimePoint_t removalTime_;
 
       DataRetrieverMQ
       (
@@ -160,6 +272,12 @@ namespace smproxy {
     AlarmParams alarmParams_;
     EventMQ totals_;
 
+    typedef std::vector<PipelineStageMQPtr> PipelineMQs;
+    PipelineMQs pipelineMQs_;
+
+    typedef std::vector<PriorityClassMQPtr> PriorityMQs;
+    PriorityMQs priorityMQs_;
+
     typedef boost::shared_ptr<DataRetrieverMQ> DataRetrieverMQPtr;
     typedef std::map<ConnectionID, DataRetrieverMQPtr> RetrieverMqMap;
     RetrieverMqMap retrieverMqMap_;
@@ -167,9 +285,21 @@ namespace smproxy {
     typedef std::map<std::string, EventMQPtr> ConnectionMqMap;
     ConnectionMqMap connectionMqMap_;
 
+    // All EventMQs in the maps above. The list is replaced whenever
+    // the maps change. Thus, the statistics can be calculated on a
+    // copy of the pointer without holding the statsMutex_.
+    typedef std::vector<EventMQPtr> EventMQs;
+    typedef boost::shared_ptr<const EventMQs> EventMQsPtr;
+    EventMQsPtr eventMQs_;
+
     mutable boost::mutex statsMutex_;
     ConnectionID nextConnectionId_;
+    bool keepConnectionsOnReset_;
+    const stor::utils::Duration_t removedConnectionLifetime_;
+    stor::utils::TimePoint_t nextRemovalTime_;
 
+    void updateEventMQs();
+    void removeExpiredConnections(const stor::utils::TimePoint_t& now);
     void sendAlarms();
     void checkForCorruptedEvents();
     virtual void do_calculateStatistics();
@@ -184,21 +314,17 @@ namespace smproxy {
       EventTypeMqMap(const stor::utils::Duration_t& updateInterval)
       : updateInterval_(updateInterval) {}
 
-      bool insert(const stor::RegPtr);
-      bool addSample(const stor::RegPtr, const double& sizeKB);
-      bool receivedCorruptedEvent(const stor::RegPtr);
+      EventMQPtr insert(const stor::RegPtr);
       void getStats(SummaryStats::EventTypeStatList&) const;
-      void calculateStatistics();
+      void appendEventMQs(EventMQs&) const;
+      void eraseUnused(const EventMQs& inUse);
+      void reset();
       void clear();
 
     private:
 
-      bool insert(const stor::EventConsRegPtr);
-      bool insert(const stor::DQMEventConsRegPtr);
-      bool addSample(const stor::EventConsRegPtr, const double& sizeKB);
-      bool addSample(const stor::DQMEventConsRegPtr, const double& sizeKB);
-      bool receivedCorruptedEvent(const stor::EventConsRegPtr);
-      bool receivedCorruptedEvent(const stor::DQMEventConsRegPtr);
+      EventMQPtr insert(const stor::EventConsRegPtr);
+      EventMQPtr insert(const stor::DQMEventConsRegPtr);
       
       typedef std::map<stor::EventConsRegPtr, EventMQPtr,
                        stor::utils::ptrComp<stor::EventConsumerRegistrationInfo>
@@ -0,0 +1,125 @@
+// $Id$
+/// @file: EventCapture.h 
+
+#ifndef EventFilter_SMProxyServer_EventCapture_h
+#define EventFilter_SMProxyServer_EventCapture_h
+
+#include "EventFilter/SMProxyServer/interface/ConnectionID.h"
+#include "EventFilter/StorageManager/interface/CurlInterface.h"
+#include "EventFilter/StorageManager/interface/Utils.h"
+
+#include <cstdio>
+#include <stdint.h>
+#include <string>
+
+
+namespace smproxy {
+
+  /**
+   * A message retrieved from an SM as stored in a capture file
+   */
+  struct CapturedMessage
+  {
+    uint64_t offset;             // microseconds since the start of the capture
+    ConnectionID connectionId;   // connection the message was retrieved from
+    stor::CurlInterface::Content data;
+  };
+
+
+  /**
+   * Records the raw messages retrieved from the SMs together with
+   * the time they were received. The file consists of a short file
+   * header followed by a 16 Byte record header and the message for
+   * each record. Recording stops once the file reaches its maximum size.
+   * This class is not thread-safe.
+   *
+   * $Author$
+   * $Revision$
+   * $Date$
+   */
+
+  class EventCapture
+  {
+  public:
+
+    /**
+     * Create the capture file limited to the given size in Bytes
+     */
+    EventCapture(const std::string& fileName, const size_t maxSize);
+
+    ~EventCapture();
+
+    /**
+     * Record the message retrieved from the given connection.
+     * Returns false if the file has reached its maximum size.
+     */
+    bool write(const ConnectionID&, const stor::CurlInterface::Content&);
+
+    /**
+     * Return the number of Bytes written to the file
+     */
+    size_t size() const
+    { return size_; }
+
+  private:
+
+    //Prevent copying of the EventCapture
+    EventCapture(EventCapture const&);
+    EventCapture& operator=(EventCapture const&);
+
+    const std::string fileName_;
+    const size_t maxSize_;
+    const stor::utils::TimePoint_t startTime_;
+    FILE* file_;
+    size_t size_;
+  };
+
+
+  /**
+   * Reads back the messages recorded by EventCapture
+   *
+   * $Author$
+   * $Revision$
+   * $Date$
+   */
+
+  class EventCaptureReader
+  {
+  public:
+
+    explicit EventCaptureReader(const std::string& fileName);
+
+    ~EventCaptureReader();
+
+    /**
+     * Read the next message. Returns false at the end of the file.
+     * A truncated last record is ignored.
+     */
+    bool next(CapturedMessage&);
+
+    /**
+     * Start again from the first message
+     */
+    void rewind();
+
+  private:
+
+    //Prevent copying of the EventCaptureReader
+    EventCaptureReader(EventCaptureReader const&);
+    EventCaptureReader& operator=(EventCaptureReader const&);
+
+    const std::string fileName_;
+    FILE* file_;
+  };
+  
+} // namespace smproxy
+
+#endif // EventFilter_SMProxyServer_EventCapture_h 
+
+
+/// emacs configuration
+/// Local Variables: -
+/// mode: c++ -
+/// c-basic-offset: 2 -
+/// indent-tabs-mode: nil -
+/// End: -
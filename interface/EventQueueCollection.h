@@ -1,30 +1,152 @@
 // $Id: EventQueueCollection.h,v 1.1.4.2 2011/03/07 12:01:12 mommsen Exp $
-/// @file: EventQueueCollection.h 
+/// @file: EventQueueCollection.h
 
 #ifndef EventFilter_SMProxyServer_EventQueueCollection_h
 #define EventFilter_SMProxyServer_EventQueueCollection_h
 
+#include "EventFilter/SMProxyServer/interface/ConsumerExpiryWheel.h"
 #include "EventFilter/SMProxyServer/interface/EventMsg.h"
+#include "EventFilter/StorageManager/interface/ConsumerID.h"
 #include "EventFilter/StorageManager/interface/QueueCollection.h"
+#include "EventFilter/StorageManager/interface/QueueID.h"
+#include "EventFilter/StorageManager/interface/RegistrationInfoBase.h"
+#include "EventFilter/StorageManager/interface/Utils.h"
 
 #include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include <map>
 
 namespace smproxy {
 
   /**
    * A collection of ConcurrentQueue<EventMsgSharedPtr>.
    *
+   * The expiry deadlines of the consumer queues are kept in a
+   * timer wheel which is updated whenever a consumer picks up
+   * an event. Thus, clearing the stale queues only touches the
+   * queues which have expired. The deadlines of an expired queue
+   * are forgotten. Its consumer has to register again.
+   *
+   * The methods maintaining the deadlines hide the non-virtual ones
+   * of stor::QueueCollection. Thus, the queues must only be used
+   * through this class, never through a stor::QueueCollection
+   * reference or pointer.
+   *
    * $Author: mommsen $
    * $Revision: 1.1.4.2 $
    * $Date: 2011/03/07 12:01:12 $
    */
-  
-  typedef stor::QueueCollection<EventMsg> EventQueueCollection;
+
+  class EventQueueCollection : public stor::QueueCollection<EventMsg>
+  {
+  public:
+
+    /**
+     * The number of active consumers among the queues attached to it
+     */
+    class ActiveConsumers
+    {
+    public:
+
+      ActiveConsumers() : count_(0) {}
+
+      size_t count() const
+      {
+        boost::mutex::scoped_lock sl(mutex_);
+        return count_;
+      }
+
+    private:
+
+      friend class EventQueueCollection;
+
+      size_t count_;
+      mutable boost::mutex mutex_;
+    };
+    typedef boost::shared_ptr<ActiveConsumers> ActiveConsumersPtr;
+
+
+    explicit EventQueueCollection
+    (
+      stor::ConsumerMonitorCollection&,
+      const stor::utils::Duration_t& expiryResolution = boost::posix_time::milliseconds(100)
+    );
+
+    /**
+     * Create a new queue for the given consumer and
+     * schedule its expiry
+     */
+    stor::QueueID createQueue
+    (
+      const stor::RegPtr,
+      const stor::utils::TimePoint_t& now = stor::utils::getCurrentTime()
+    );
+
+    /**
+     * Remove all queues
+     */
+    void removeQueues();
+
+    /**
+     * Pop an event for the given consumer and
+     * move the expiry deadline of its queue
+     */
+    ValueType popEvent(const stor::ConsumerID&);
+
+    /**
+     * Return true if the consumer of the given queue has
+     * not picked up any event within its stale time
+     */
+    bool stale(const stor::QueueID&, const stor::utils::TimePoint_t&);
+
+    /**
+     * Clear the queues whose deadline has passed and
+     * forget their deadlines and consumers
+     */
+    void clearStaleQueues(const stor::utils::TimePoint_t&);
+
+    /**
+     * Count the given queue in the active consumers while
+     * it has not expired
+     */
+    void attachActiveConsumers(const stor::QueueID&, ActiveConsumersPtr);
+
+    /**
+     * Return the resolution of the expiry deadlines
+     */
+    const stor::utils::Duration_t& expiryResolution() const
+    { return expiryWheel_.resolution(); }
+
+
+  private:
+
+    typedef stor::QueueCollection<EventMsg> Base;
+
+    void setActive(const stor::QueueID&, const stor::utils::TimePoint_t& now);
+
+    struct QueueExpiry
+    {
+      stor::utils::Duration_t secondsToStale;
+      stor::utils::TimePoint_t deadline;
+      bool active;
+      ActiveConsumersPtr activeConsumers;
+    };
+    typedef std::map<stor::QueueID, QueueExpiry> QueueExpiries;
+    QueueExpiries queueExpiries_;
+
+    typedef std::map<stor::ConsumerID, stor::QueueID> QueueIDsByConsumerID;
+    QueueIDsByConsumerID queueIDsByConsumerID_;
+
+    ConsumerExpiryWheel expiryWheel_;
+    mutable boost::mutex expiryMutex_;
+  };
+
   typedef boost::shared_ptr<EventQueueCollection> EventQueueCollectionPtr;
-  
+
 } // namespace smproxy
 
-#endif // EventFilter_SMProxyServer_EventQueueCollection_h 
+#endif // EventFilter_SMProxyServer_EventQueueCollection_h
 
 
 
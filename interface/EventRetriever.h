@@ -4,11 +4,21 @@
 #ifndef EventFilter_SMProxyServer_EventRetriever_h
 #define EventFilter_SMProxyServer_EventRetriever_h
 
+#include "EventFilter/SMProxyServer/interface/BandwidthLimiter.h"
 #include "EventFilter/SMProxyServer/interface/Configuration.h"
 #include "EventFilter/SMProxyServer/interface/ConnectionID.h"
+#include "EventFilter/SMProxyServer/interface/ConsumerPriority.h"
 #include "EventFilter/SMProxyServer/interface/DataRetrieverMonitorCollection.h"
 #include "EventFilter/SMProxyServer/interface/DQMEventMsg.h"
+#include "EventFilter/SMProxyServer/interface/EventCapture.h"
+#include "EventFilter/SMProxyServer/interface/EventMsg.h"
 #include "EventFilter/SMProxyServer/interface/EventQueueCollection.h"
+#include "EventFilter/SMProxyServer/interface/EventSpool.h"
+#include "EventFilter/SMProxyServer/interface/ReconnectManager.h"
+#include "EventFilter/SMProxyServer/interface/SMRequestSlots.h"
+#include "EventFilter/SMProxyServer/interface/TokenBucket.h"
+#include "EventFilter/SMProxyServer/interface/TriggerMask.h"
+#include "EventFilter/StorageManager/interface/ConcurrentQueue.h"
 #include "EventFilter/StorageManager/interface/DQMEventStore.h"
 #include "EventFilter/StorageManager/interface/EventServerProxy.h"
 #include "EventFilter/StorageManager/interface/EventConsumerRegistrationInfo.h"
@@ -16,10 +26,13 @@
 #include "EventFilter/StorageManager/interface/Utils.h"
 #include "FWCore/ParameterSet/interface/ParameterSet.h"
 
+#include <boost/function.hpp>
 #include <boost/scoped_ptr.hpp>
 #include <boost/shared_ptr.hpp>
+#include <boost/thread/condition_variable.hpp>
 #include <boost/thread/thread.hpp>
 
+#include <map>
 #include <string>
 #include <vector>
 
@@ -45,10 +58,19 @@ namespace smproxy {
 
     typedef boost::shared_ptr<RegInfo> RegInfoPtr;
 
+    typedef stor::EventServerProxy<RegInfo> EventServer;
+    typedef boost::shared_ptr<EventServer> EventServerPtr;
+    typedef std::map<std::string, EventServerPtr> EventServersByURL;
+
+    /**
+     * The EventRetriever uses the already connected event servers
+     * passed in instead of opening new connections to these SMs.
+     */
     EventRetriever
     (
       StateMachine*,
-      const RegInfoPtr
+      const RegInfoPtr,
+      const EventServersByURL& prewarmedEventServers = EventServersByURL()
     );
 
     ~EventRetriever();
@@ -63,11 +85,22 @@ namespace smproxy {
      */
     void stop();
 
+    /**
+     * Stop serving events at the end of a run,
+     * but keep the connections to the SMs open
+     */
+    void pause();
+
+    /**
+     * Serve the events of a new run. The run-scoped state
+     * is refreshed before the first event is retrieved.
+     */
+    void resume();
+
     /**
      * Return the list of QueueIDs attached to the EventRetriever
      */
-    const stor::QueueIDs& getQueueIDs() const
-    { return queueIDs_; }
+    stor::QueueIDs getQueueIDs() const;
 
     /**
      * Return the number of active connections to SMs
@@ -78,18 +111,50 @@ namespace smproxy {
  
   private:
 
-    void activity(const edm::ParameterSet&);
+    std::string threadName(const std::string& stageName) const;
+    void activity(const std::string& stageName, const boost::function<void()>&);
     void doIt(const edm::ParameterSet&);
+    void fetchEvents();
+    void buildEvents();
+    void enqueueEvents();
+    void replayEvents(QueueCollectionPtr);
     void do_stop();
+    void do_pause();
+    bool isPaused() const;
+    bool stopRequested() const;
+    bool waitWhilePaused();
     bool connect(const edm::ParameterSet&);
+    void openCapture();
+    void capture(const stor::CurlInterface::Content&);
     void connectToSM(const std::string& sourceURL, const edm::ParameterSet&);
+    ConnectionID addConnection(const std::string& sourceURL, const edm::ParameterSet&);
     bool openConnection(const ConnectionID&, const RegInfoPtr);
     bool tryToReconnect();
+    bool updateSMConnections();
     void getInitMsg();
     bool getNextEvent(stor::CurlInterface::Content&);
     bool adjustMinEventRequestInterval(const stor::utils::Duration_t&);
     void updateConsumersSetting(const stor::utils::Duration_t&);
+    void adjustRequestRate(const RegInfoPtr);
     bool anyActiveConsumers(QueueCollectionPtr) const;
+    void pruneConsumers(QueueCollectionPtr);
+    void trackActivity(const stor::QueueID&);
+    ConsumerPriority retrieverPriority(const RegInfoPtr) const;
+    bool shedEvent(const size_t backlog) const;
+    size_t availableCredit
+    (
+      QueueCollectionPtr,
+      const stor::utils::TimePoint_t& now,
+      stor::utils::TimePoint_t& nextTokenTime
+    );
+    void selectConsumers
+    (
+      QueueCollectionPtr,
+      const stor::utils::TimePoint_t& now,
+      const TriggerMask::Words& acceptedPaths,
+      stor::QueueIDs&
+    );
+    bool allQueuesFull(QueueCollectionPtr, const stor::QueueIDs&) const;
     void disconnectFromCurrentSM();
     void processCompletedTopLevelFolders();
     
@@ -98,30 +163,155 @@ namespace smproxy {
     EventRetriever& operator=(EventRetriever const&);
 
     StateMachine* stateMachine_;
-    const DataRetrieverParams dataRetrieverParams_;
+    const ConfigurationSnapshotPtr configuration_;
+    const DataRetrieverParams& dataRetrieverParams_;
     DataRetrieverMonitorCollection& dataRetrieverMonitorCollection_;
 
+    /**
+     * All consumers of a retriever belong to the same priority class.
+     * The threads of lower priority retrievers are reniced relative to
+     * the thread creating the retriever and shed events under load.
+     */
+    const ConsumerPriority priority_;
+    const int baseNice_;
+
+    /**
+     * The retriever draws from the bandwidth shared by all
+     * retrievers with the weight of its priority class
+     */
+    BandwidthLimiterPtr bandwidthLimiter_;
+    const BandwidthLimiter::FlowID bandwidthFlow_;
+    SMRequestSlotsPtr smRequestSlots_;
+
     stor::utils::TimePoint_t nextRequestTime_;
     stor::utils::Duration_t minEventRequestInterval_;
 
     boost::scoped_ptr<boost::thread> thread_;
+    boost::thread_group pipelineThreads_;
     static size_t retrieverCount_;
     size_t instance_;
 
-    typedef stor::EventServerProxy<RegInfo> EventServer;
-    typedef boost::shared_ptr<EventServer> EventServerPtr;
     typedef std::map<ConnectionID, EventServerPtr> EventServers;
     EventServers eventServers_;
     typename EventServers::iterator nextSMtoUse_;
+    EventServersByURL prewarmedEventServers_;
 
     typedef std::vector<ConnectionID> ConnectionIDs;
     ConnectionIDs connectionIDs_;
     mutable boost::mutex connectionIDsLock_;
 
-    stor::utils::TimePoint_t nextReconnectTry_;
+    struct Connection
+    {
+      RegInfoPtr regPtr;
+      std::string sourceURL;
+    };
+    typedef std::map<ConnectionID, Connection> Connections;
+    Connections connections_;
+
+    /**
+     * Lost connections are re-opened in the background.
+     * They are picked up by tryToReconnect.
+     */
+    ReconnectManager<RegInfo> reconnectManager_;
+
+    /**
+     * The SMs currently connected to. Changes of the SMRegistrationList
+     * are applied on the next reconnect attempt using the same
+     * parameter set as the initial connections. The list is only
+     * compared once the configuration version has changed.
+     */
+    DataRetrieverParams::SMRegistrationList smRegistrationList_;
+    edm::ParameterSet connectionPSet_;
+    uint32_t configurationVersion_;
+
+    bool paused_;
+    bool newRun_;
+    bool stopping_;
+    mutable boost::mutex pauseLock_;
+    boost::condition_variable resumed_;
+
+    /**
+     * If enabled, the raw messages retrieved from the SMs are
+     * recorded with their arrival time for replaying them later.
+     */
+    boost::scoped_ptr<EventCapture> eventCapture_;
+
+    /**
+     * Data events are retrieved in a pipeline of 3 threads connected
+     * by bounded queues: the fetch stage waits for the events from the
+     * SMs, the build stage parses and copies them into an EventMsg,
+     * and the enqueue stage tags the events for the consumers.
+     */
+    struct FetchedEvent
+    {
+      ConnectionID connectionId;
+      boost::shared_ptr<stor::CurlInterface::Content> data;
+    };
+    stor::ConcurrentQueue<FetchedEvent> fetchedEvents_;
+
+    struct BuiltEvent
+    {
+      ConnectionID connectionId;
+      size_t size;
+      EventMsg event;
+      TriggerMask::Words acceptedPaths;
+    };
+    stor::ConcurrentQueue<BuiltEvent> builtEvents_;
+
+    /**
+     * The events fetched but not yet handed to the consumers will use
+     * up some of the consumer credit. Thus, the fetch stage only asks
+     * for more events than are in flight.
+     */
+    size_t inFlightEvents_;
+    mutable boost::mutex inFlightLock_;
+    boost::condition_variable eventDelivered_;
+    size_t inFlightEvents() const;
+    void eventDelivered();
+    void waitForDeliveredEvent(const stor::utils::TimePoint_t& deadline);
+
+    /**
+     * If enabled, the data events are spooled to disk. Newly added
+     * consumers first catch up with the spooled events before they
+     * receive the freshly retrieved events.
+     */
+    bool spoolEvents_;
+    std::string spoolFileName_;
+    boost::scoped_ptr<EventSpool> eventSpool_;
+
+    /**
+     * Each consumer gets its own token bucket refilled at the
+     * rate requested by the consumer. An event is only handed to
+     * the consumers whose trigger mask accepts the event, whose
+     * prescale counter fires, and which have a token left.
+     */
+    struct Consumer
+    {
+      stor::QueueID queueId;
+      TokenBucket tokenBucket;
+      unsigned int prescale;
+      unsigned int eventCount;
+      std::string triggerSelection;
+      TriggerMask::Strings eventSelection;
+      TriggerMask triggerMask;
+      bool replaying;
+      bool replayPositioned;
+      stor::utils::TimePoint_t replaySince;
+      uint64_t replaySequence;
+
+      explicit Consumer(const RegInfoPtr);
+    };
+    void compileTriggerMask(Consumer&) const;
+    void startReplay(Consumer&) const;
+    void updateConsumerMasks();
 
-    stor::QueueIDs queueIDs_;
-    mutable boost::mutex queueIDsLock_;
+    typedef std::vector<Consumer> Consumers;
+    Consumers consumers_;
+    TriggerMaskSet consumerMasks_;
+    EventQueueCollection::ActiveConsumersPtr activeConsumers_;
+    TriggerMask::Strings hltTriggerNames_;
+    mutable boost::mutex consumersLock_;
+    bool routeByTriggerBits_;
 
     stor::DQMEventStore<DQMEventMsg,
                         EventRetriever<RegInfo,QueueCollectionPtr>,
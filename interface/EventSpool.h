@@ -0,0 +1,126 @@
+// $Id$
+/// @file: EventSpool.h 
+
+#ifndef EventFilter_SMProxyServer_EventSpool_h
+#define EventFilter_SMProxyServer_EventSpool_h
+
+#include "EventFilter/StorageManager/interface/Utils.h"
+
+#include <boost/thread/mutex.hpp>
+
+#include <deque>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+
+namespace smproxy {
+
+  /**
+   * Append-only spool of the most recent events kept in a
+   * memory-mapped ring file. Once the file is full, the oldest
+   * events are overwritten. The events found in an existing file
+   * are recovered when the spool is opened, i.e. they survive
+   * a restart of the application.
+   *
+   * $Author$
+   * $Revision$
+   * $Date$
+   */
+
+  class EventSpool
+  {
+  public:
+
+    typedef std::vector<unsigned char> Buffer;
+
+    /**
+     * Open or create the spool file with the given size in Bytes.
+     * The file is locked exclusively while the spool is open.
+     * Raises exception::EventSpool if the file is already in use.
+     */
+    EventSpool(const std::string& fileName, const size_t size);
+
+    ~EventSpool();
+
+    /**
+     * Append the event to the spool.
+     * Returns false if the event is too large for the spool.
+     */
+    bool append(const unsigned char* data, const size_t length);
+
+    /**
+     * Return the sequence number of the first event spooled
+     * at or after the given time.
+     */
+    uint64_t firstSequenceSince(const stor::utils::TimePoint_t&) const;
+
+    /**
+     * Copy the event with the given sequence number into the buffer.
+     * If the event has already been overwritten, the oldest spooled
+     * event is returned and the sequence number is updated accordingly.
+     * Returns false if no event with this or a later sequence number exists.
+     */
+    bool read(uint64_t& sequence, Buffer&) const;
+
+    /**
+     * Return the number of events in the spool
+     */
+    size_t eventCount() const;
+
+
+  private:
+
+    struct RecordHeader
+    {
+      uint32_t magic;
+      uint32_t length;
+      uint64_t sequence;
+      uint64_t timestamp; // microseconds since epoch
+      uint32_t payloadChecksum; // adler32 of the event data
+      uint32_t reserved;
+      uint64_t checksum;
+    };
+
+    struct Entry
+    {
+      uint64_t sequence;
+      uint64_t timestamp;
+      size_t offset;
+      size_t recordSize;
+    };
+    typedef std::deque<Entry> Index;
+
+    static uint64_t checksum(const RecordHeader&);
+    static size_t recordSize(const size_t length);
+    static uint64_t toMicroseconds(const stor::utils::TimePoint_t&);
+    bool validHeader(const size_t offset) const;
+    void recover();
+    void evict(const size_t offset, const size_t recordSize);
+
+    //Prevent copying of the EventSpool
+    EventSpool(EventSpool const&);
+    EventSpool& operator=(EventSpool const&);
+
+    const std::string fileName_;
+    const size_t size_;
+    int fd_;
+    unsigned char* map_;
+
+    Index index_;
+    size_t head_;
+    uint64_t nextSequence_;
+    mutable boost::mutex mutex_;
+  };
+  
+} // namespace smproxy
+
+#endif // EventFilter_SMProxyServer_EventSpool_h 
+
+
+/// emacs configuration
+/// Local Variables: -
+/// mode: c++ -
+/// c-basic-offset: 2 -
+/// indent-tabs-mode: nil -
+/// End: -
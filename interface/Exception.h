@@ -78,6 +78,16 @@ XCEPT_DEFINE_EXCEPTION(smproxy, StateTransition)
  */
 XCEPT_DEFINE_EXCEPTION(smproxy, CorruptedEvents)
 
+/**
+ * Event spool problem
+ */
+XCEPT_DEFINE_EXCEPTION(smproxy, EventSpool)
+
+/**
+ * Event capture problem
+ */
+XCEPT_DEFINE_EXCEPTION(smproxy, EventCapture)
+
 
 #endif // EventFilter_SMProxyServer_Exception_h
 
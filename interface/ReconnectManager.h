@@ -0,0 +1,138 @@
+// $Id$
+/// @file: ReconnectManager.h
+
+#ifndef EventFilter_SMProxyServer_ReconnectManager_h
+#define EventFilter_SMProxyServer_ReconnectManager_h
+
+#include "EventFilter/SMProxyServer/interface/ConnectionID.h"
+#include "EventFilter/SMProxyServer/interface/DataRetrieverMonitorCollection.h"
+#include "EventFilter/SMProxyServer/interface/ThreadMonitorCollection.h"
+#include "EventFilter/StorageManager/interface/EventServerProxy.h"
+#include "EventFilter/StorageManager/interface/Utils.h"
+
+#include <boost/scoped_ptr.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+
+#include <map>
+#include <string>
+#include <vector>
+
+
+namespace smproxy {
+
+  /**
+   * Re-opens the connections to SMs in the background.
+   *
+   * The retriever hands over the connections it lost. Each one is
+   * retried after a delay which starts at the base delay and doubles
+   * with every failed attempt up to the maximum delay. The delays are
+   * randomized by +-25% such that the retrievers do not hit a
+   * recovering SM all at once. The re-opened connections are collected
+   * until the retriever takes them all at once.
+   *
+   * The background thread is monitored under the given name and
+   * pinned to the CPU list of the given instance like the threads
+   * of the retriever owning it.
+   *
+   * $Author$
+   * $Revision$
+   * $Date$
+   */
+
+  template<class RegInfo>
+  class ReconnectManager
+  {
+  public:
+
+    typedef boost::shared_ptr<RegInfo> RegInfoPtr;
+    typedef stor::EventServerProxy<RegInfo> EventServer;
+    typedef boost::shared_ptr<EventServer> EventServerPtr;
+    typedef std::map<ConnectionID, EventServerPtr> EventServers;
+
+    ReconnectManager
+    (
+      DataRetrieverMonitorCollection&,
+      ThreadMonitorCollection&,
+      const std::string& threadName,
+      const std::string& cpuLists,
+      const size_t instance,
+      const stor::utils::Duration_t& baseDelay,
+      const stor::utils::Duration_t& maxDelay
+    );
+
+    ~ReconnectManager();
+
+    /**
+     * Re-open the given connection in the background. A new connection
+     * is opened right away, a lost one only after the back-off delay.
+     */
+    void schedule(const ConnectionID&, const RegInfoPtr, const bool newConnection = false);
+
+    /**
+     * Stop trying to re-open the given connection
+     */
+    void cancel(const ConnectionID&);
+
+    /**
+     * Move the re-opened connections into the given map.
+     * Returns false if there are none.
+     */
+    bool takeReopened(EventServers&);
+
+    /**
+     * Stop the background thread. Pending connections are dropped.
+     */
+    void stop();
+
+
+  private:
+
+    struct Pending
+    {
+      RegInfoPtr regPtr;
+      unsigned int attempts;
+      stor::utils::TimePoint_t nextTry;
+    };
+    typedef std::map<ConnectionID, Pending> PendingConnections;
+
+    void activity();
+    void reconnect(const ConnectionID&, Pending);
+    stor::utils::Duration_t backoff(const unsigned int attempts);
+
+    //Prevent copying of the ReconnectManager
+    ReconnectManager(ReconnectManager const&);
+    ReconnectManager& operator=(ReconnectManager const&);
+
+    DataRetrieverMonitorCollection& dataRetrieverMonitorCollection_;
+    ThreadMonitorCollection& threadMonitorCollection_;
+    const std::string threadName_;
+    const std::string cpuLists_;
+    const size_t instance_;
+    const stor::utils::Duration_t baseDelay_;
+    const stor::utils::Duration_t maxDelay_;
+    unsigned int seed_;
+
+    PendingConnections pending_;
+    EventServers reopened_;
+    ConnectionID connecting_;
+    bool cancelled_;
+    mutable boost::mutex mutex_;
+    boost::condition_variable scheduled_;
+
+    boost::scoped_ptr<boost::thread> thread_;
+  };
+
+} // namespace smproxy
+
+#endif // EventFilter_SMProxyServer_ReconnectManager_h
+
+
+/// emacs configuration
+/// Local Variables: -
+/// mode: c++ -
+/// c-basic-offset: 2 -
+/// indent-tabs-mode: nil -
+/// End: -
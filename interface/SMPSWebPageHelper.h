@@ -6,6 +6,7 @@
 
 #include "EventFilter/SMProxyServer/interface/EventQueueCollection.h"
 #include "EventFilter/SMProxyServer/interface/StateMachine.h"
+#include "EventFilter/SMProxyServer/interface/ThreadMonitorCollection.h"
 #include "EventFilter/StorageManager/interface/ConsumerWebPageHelper.h"
 #include "EventFilter/StorageManager/interface/WebPageHelper.h"
 
@@ -51,6 +52,11 @@ namespace smproxy {
        Generates consumer statistics page
     */
     void consumerStatisticsWebPage(xgi::Output*) const;
+
+    /**
+       Generates the thread statistics page
+    */
+    void threadStatisticsWebPage(xgi::Output*) const;
     
     
   private:
@@ -60,6 +66,12 @@ namespace smproxy {
      */
     virtual void addDOMforHyperLinks(stor::XHTMLMaker&, stor::XHTMLMaker::Node* parent) const;
 
+    /**
+     * Adds the statistics per consumer priority class followed
+     * by the hyperlinks to the consumer statistics page
+     */
+    void addDOMforConsumerPriorities(stor::XHTMLMaker&, stor::XHTMLMaker::Node* parent) const;
+
     /**
      * Adds the connection info to the parent DOM element
      */
@@ -129,6 +141,35 @@ namespace smproxy {
       DataRetrieverMonitorCollection::ConnectionStats::const_iterator
     ) const;
  
+    /**
+     * Adds the bandwidth used versus the configured caps to the parent DOM element
+     */
+    void addDOMforBandwidth
+    (
+      stor::XHTMLMaker&,
+      stor::XHTMLMaker::Node* parent
+    ) const;
+ 
+    /**
+     * Adds a table row for the bandwidth used versus the given cap in bytes per second
+     */
+    void addRowForBandwidth
+    (
+      stor::XHTMLMaker&,
+      stor::XHTMLMaker::Node* tableRow,
+      DataRetrieverMonitorCollection::EventStats const&,
+      const double& limit
+    ) const;
+ 
+    /**
+     * Adds the data event retrieval pipeline statistics to the parent DOM element
+     */
+    void addDOMforRetrievalPipeline
+    (
+      stor::XHTMLMaker&,
+      stor::XHTMLMaker::Node* parent
+    ) const;
+ 
     /**
      * Adds a table cell for the SM host
      */
@@ -139,6 +180,25 @@ namespace smproxy {
       const std::string& sourceURL
     ) const;
 
+    /**
+     * Adds the resource usage of the monitored threads to the parent DOM element
+     */
+    void addDOMforThreads
+    (
+      stor::XHTMLMaker&,
+      stor::XHTMLMaker::Node* parent
+    ) const;
+ 
+    /**
+     * Adds a table row for each monitored thread
+     */
+    void addRowForThread
+    (
+      stor::XHTMLMaker&,
+      stor::XHTMLMaker::Node* table,
+      ThreadMonitorCollection::ThreadStats const&
+    ) const;
+
     /**
      * Adds the DQM event (histogram) servers to the parent DOM element
      */
@@ -90,6 +90,13 @@ namespace smproxy {
     void dqmEventStatisticsWebPage(xgi::Input *in, xgi::Output *out)
       throw (xgi::exception::Exception);
 
+    /**
+     * Webinterface callback creating web page showing the resource
+     * usage of the monitored threads
+     */
+    void threadStatisticsWebPage(xgi::Input *in, xgi::Output *out)
+      throw (xgi::exception::Exception);
+
     /**
      * Bind callbacks for consumers
      */
@@ -0,0 +1,100 @@
+// $Id$
+/// @file: SMRequestSlots.h
+
+#ifndef EventFilter_SMProxyServer_SMRequestSlots_h
+#define EventFilter_SMProxyServer_SMRequestSlots_h
+
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include <map>
+#include <string>
+
+
+namespace smproxy {
+
+  /**
+   * Limits the number of requests outstanding at the same time
+   * to each SM host, counted over all event retrievers.
+   *
+   * $Author$
+   * $Revision$
+   * $Date$
+   */
+
+  class SMRequestSlots
+  {
+  public:
+
+    SMRequestSlots();
+
+    /**
+     * Set the maximum number of outstanding requests per SM host.
+     * 0 means unlimited.
+     */
+    void setLimit(const unsigned int maxRequestsPerHost);
+
+    /**
+     * Wait for a free slot for a request to the SM with the given URL.
+     * This is an interruption point.
+     */
+    void acquire(const std::string& sourceURL);
+
+    /**
+     * Free the slot taken for a request to the SM with the given URL
+     */
+    void release(const std::string& sourceURL);
+
+    /**
+     * Return the number of requests outstanding per SM host
+     */
+    typedef std::map<std::string, unsigned int> RequestCounts;
+    void getOutstandingRequests(RequestCounts&) const;
+
+    /**
+     * Return the host name of the given SM URL
+     */
+    static std::string getHost(const std::string& sourceURL);
+
+    /**
+     * Holds a slot for the lifetime of the object
+     */
+    class Slot
+    {
+    public:
+      Slot(SMRequestSlots&, const std::string& sourceURL);
+      ~Slot();
+
+    private:
+      //Prevent copying of the Slot
+      Slot(Slot const&);
+      Slot& operator=(Slot const&);
+
+      SMRequestSlots& slots_;
+      const std::string sourceURL_;
+    };
+
+
+  private:
+
+    unsigned int limit_;
+    RequestCounts outstanding_;
+
+    mutable boost::mutex mutex_;
+    boost::condition_variable released_;
+  };
+
+  typedef boost::shared_ptr<SMRequestSlots> SMRequestSlotsPtr;
+
+} // namespace smproxy
+
+#endif // EventFilter_SMProxyServer_SMRequestSlots_h
+
+
+/// emacs configuration
+/// Local Variables: -
+/// mode: c++ -
+/// c-basic-offset: 2 -
+/// indent-tabs-mode: nil -
+/// End: -
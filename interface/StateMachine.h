@@ -4,9 +4,11 @@
 #ifndef EventFilter_SMProxyServer_StateMachine_h
 #define EventFilter_SMProxyServer_StateMachine_h
 
+#include "EventFilter/SMProxyServer/interface/BandwidthLimiter.h"
 #include "EventFilter/SMProxyServer/interface/Configuration.h"
 #include "EventFilter/SMProxyServer/interface/DataManager.h"
 #include "EventFilter/SMProxyServer/interface/EventQueueCollection.h"
+#include "EventFilter/SMProxyServer/interface/SMRequestSlots.h"
 #include "EventFilter/SMProxyServer/interface/StatisticsReporter.h"
 #include "EventFilter/StorageManager/interface/DQMEventQueueCollection.h"
 #include "EventFilter/StorageManager/interface/InitMsgCollection.h"
@@ -106,17 +108,25 @@ namespace smproxy
     { return dqmEventQueueCollection_; }
     StatisticsReporterPtr getStatisticsReporter() const
     { return statisticsReporter_; }
+    BandwidthLimiterPtr getBandwidthLimiter() const
+    { return bandwidthLimiter_; }
+    SMRequestSlotsPtr getSMRequestSlots() const
+    { return smRequestSlots_; }
     xdaq::ApplicationDescriptor* getApplicationDescriptor() const
     { return app_->getApplicationDescriptor(); }
 
     void updateConfiguration();
     void setQueueSizes();
     void setAlarms();
+    void setThreadAffinity();
+    void setUpstreamLimits();
+    void prewarmConnections();
     void clearInitMsgCollection();
     void resetStatistics();
     void clearConsumerRegistrations();
     void enableConsumerRegistration();
     void disableConsumerRegistration();
+    void suspendConsumerRegistration();
     void clearQueues();
     
     
@@ -132,6 +142,8 @@ namespace smproxy
     StatisticsReporterPtr statisticsReporter_;
     EventQueueCollectionPtr eventQueueCollection_;
     stor::DQMEventQueueCollectionPtr dqmEventQueueCollection_;
+    BandwidthLimiterPtr bandwidthLimiter_;
+    SMRequestSlotsPtr smRequestSlots_;
 
     mutable boost::mutex eventMutex_;
     
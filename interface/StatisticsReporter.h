@@ -11,6 +11,8 @@
 
 #include "EventFilter/SMProxyServer/interface/Configuration.h"
 #include "EventFilter/SMProxyServer/interface/DataRetrieverMonitorCollection.h"
+#include "EventFilter/SMProxyServer/interface/ThreadAffinity.h"
+#include "EventFilter/SMProxyServer/interface/ThreadMonitorCollection.h"
 #include "EventFilter/StorageManager/interface/AlarmHandler.h"
 #include "EventFilter/StorageManager/interface/EventConsumerMonitorCollection.h"
 #include "EventFilter/StorageManager/interface/DQMConsumerMonitorCollection.h"
@@ -78,6 +80,13 @@ namespace smproxy {
     { return dqmConsumerMonCollection_; }
 
 
+    const ThreadMonitorCollection& getThreadMonitorCollection() const
+    { return threadMonCollection_; }
+
+    ThreadMonitorCollection& getThreadMonitorCollection()
+    { return threadMonCollection_; }
+
+
     /**
      * Create and start the monitoring workloop
      */
@@ -93,6 +102,12 @@ namespace smproxy {
      */
     stor::AlarmHandlerPtr alarmHandler() { return alarmHandler_; }
 
+    /**
+     * Pin the monitoring workloop to the given CPUs
+     */
+    void setMonitoringCPUs(const std::string& cpuLists)
+    { monitorAffinity_.setCPUs(cpuLists); }
+
     /**
      * Update the variables put into the application info space
      */
@@ -123,8 +138,11 @@ namespace smproxy {
     stor::DQMEventMonitorCollection dqmEventMonCollection_;
     stor::EventConsumerMonitorCollection eventConsumerMonCollection_;
     stor::DQMConsumerMonitorCollection dqmConsumerMonCollection_;
+    ThreadMonitorCollection threadMonCollection_;
     toolbox::task::WorkLoop* monitorWL_;      
+    ThreadAffinity monitorAffinity_;
     bool doMonitoring_;
+    bool monitorThreadRegistered_;
 
     // Stuff dealing with the monitoring info space
     xdata::InfoSpace *infoSpace_;
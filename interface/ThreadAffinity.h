@@ -0,0 +1,76 @@
+// $Id$
+/// @file: ThreadAffinity.h
+
+#ifndef EventFilter_SMProxyServer_ThreadAffinity_h
+#define EventFilter_SMProxyServer_ThreadAffinity_h
+
+#include <boost/thread/mutex.hpp>
+
+#include <string>
+
+
+namespace smproxy {
+
+  /**
+   * Pins threads to a set of CPUs.
+   *
+   * The CPUs are given as a comma separated list of CPU numbers
+   * or ranges, e.g. "0-5,12-17". Several lists can be given
+   * separated by ';'. Each thread then picks one list by its
+   * instance number. If each list holds the CPUs of one socket,
+   * the threads of an event retriever and the event buffers they
+   * touch first stay on the same NUMA node.
+   * An empty string allows all CPUs.
+   *
+   * $Author$
+   * $Revision$
+   * $Date$
+   */
+
+  class ThreadAffinity
+  {
+  public:
+
+    ThreadAffinity();
+
+    /**
+     * Set the CPU lists for the thread calling apply()
+     */
+    void setCPUs(const std::string& cpuLists, const size_t instance = 0);
+
+    /**
+     * Pin the calling thread if the CPU lists have changed
+     * since the last call
+     */
+    void apply();
+
+    /**
+     * Raise exception::Configuration if the CPU lists are malformed
+     */
+    static void validate(const std::string& cpuLists);
+
+    /**
+     * Pin the calling thread to the CPU list selected by the instance
+     */
+    static void pinCurrentThread(const std::string& cpuLists, const size_t instance = 0);
+
+
+  private:
+
+    std::string cpuLists_;
+    size_t instance_;
+    bool changed_;
+    mutable boost::mutex mutex_;
+  };
+
+} // namespace smproxy
+
+#endif // EventFilter_SMProxyServer_ThreadAffinity_h
+
+
+/// emacs configuration
+/// Local Variables: -
+/// mode: c++ -
+/// c-basic-offset: 2 -
+/// indent-tabs-mode: nil -
+/// End: -
@@ -0,0 +1,205 @@
+// $Id$
+/// @file: ThreadMonitorCollection.h
+
+#ifndef EventFilter_SMProxyServer_ThreadMonitorCollection_h
+#define EventFilter_SMProxyServer_ThreadMonitorCollection_h
+
+#include "EventFilter/StorageManager/interface/MonitorCollection.h"
+#include "EventFilter/StorageManager/interface/MonitoredQuantity.h"
+#include "EventFilter/StorageManager/interface/Utils.h"
+
+#include "xdata/Double.h"
+#include "xdata/String.h"
+#include "xdata/Vector.h"
+
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/tss.hpp>
+
+#include <sys/types.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+
+namespace smproxy {
+
+  /**
+   * Resource usage of the long-lived threads of the proxy
+   *
+   * Each thread registers itself. The CPU time and the context
+   * switches of the registered threads are sampled from /proc by
+   * the monitoring thread. The time a thread spends blocked is
+   * added by the thread itself for each wait point.
+   *
+   * $Author$
+   * $Revision$
+   * $Date$
+   */
+
+  class ThreadMonitorCollection : public stor::MonitorCollection
+  {
+  public:
+
+    enum WaitPoint
+    {
+      SM_REQUEST_WAIT,   // waiting for the reply of an SM
+      THROTTLE_WAIT,     // waiting for bandwidth or a request slot
+      STATS_LOCK_WAIT,   // waiting for the data retriever statistics lock
+      QUEUE_WAIT,        // waiting on a queue
+      WAIT_POINTS
+    };
+
+    struct ThreadStats
+    {
+      std::string name;
+      stor::MonitoredQuantity::Stats cpuTimeStats;           //seconds
+      stor::MonitoredQuantity::Stats voluntarySwitchStats;
+      stor::MonitoredQuantity::Stats involuntarySwitchStats;
+      std::vector<stor::MonitoredQuantity::Stats> waitTimeStats; //seconds, indexed by WaitPoint
+    };
+    typedef std::vector<ThreadStats> ThreadStatList;
+
+
+    explicit ThreadMonitorCollection(const stor::utils::Duration_t& updateInterval);
+
+    /**
+     * Register the calling thread under the given name
+     */
+    void registerThread(const std::string& name);
+
+    /**
+     * Stop monitoring the calling thread
+     */
+    void unregisterThread();
+
+    /**
+     * Add the time in seconds the calling thread was blocked at the
+     * given wait point. Nothing happens if the thread is not registered.
+     */
+    static void addWaitTime(const WaitPoint&, const double& seconds);
+
+    /**
+     * Take the given lock, accounting the time blocked to the wait point
+     */
+    template<class Lock>
+    static void lock(Lock&, const WaitPoint&);
+
+    /**
+     * Write the statistics of each registered thread into the given list
+     */
+    void getStats(ThreadStatList&) const;
+
+    /**
+     * Return a printable name of the wait point
+     */
+    static std::string waitPointName(const WaitPoint&);
+
+    /**
+     * Registers the calling thread for the lifetime of the object
+     */
+    class Registration
+    {
+    public:
+      Registration(ThreadMonitorCollection&, const std::string& name);
+      ~Registration();
+
+    private:
+      //Prevent copying of the Registration
+      Registration(Registration const&);
+      Registration& operator=(Registration const&);
+
+      ThreadMonitorCollection& threadMonitorCollection_;
+    };
+
+    /**
+     * Accounts the lifetime of the object to the given wait point
+     */
+    class WaitTimer
+    {
+    public:
+      explicit WaitTimer(const WaitPoint&);
+      ~WaitTimer();
+
+    private:
+      const WaitPoint waitPoint_;
+      const stor::utils::TimePoint_t startTime_;
+    };
+
+
+  private:
+
+    struct ThreadMQ
+    {
+      const std::string name_;
+      const pid_t threadId_;
+      double lastCPUTime_;
+      long lastVoluntarySwitches_;
+      long lastInvoluntarySwitches_;
+
+      stor::MonitoredQuantity cpuTime_;             //seconds
+      stor::MonitoredQuantity voluntarySwitches_;
+      stor::MonitoredQuantity involuntarySwitches_;
+      typedef boost::shared_ptr<stor::MonitoredQuantity> MQPtr;
+      std::vector<MQPtr> waitTime_;                 //seconds
+
+      ThreadMQ
+      (
+        const std::string& name,
+        const pid_t threadId,
+        const stor::utils::Duration_t& updateInterval
+      );
+      void sample();
+      void getStats(ThreadStats&) const;
+      void calculateStatistics();
+      void reset();
+    };
+    typedef boost::shared_ptr<ThreadMQ> ThreadMQPtr;
+    typedef std::map<pid_t, ThreadMQPtr> ThreadMqMap;
+
+    //Prevent copying of the ThreadMonitorCollection
+    ThreadMonitorCollection(ThreadMonitorCollection const&);
+    ThreadMonitorCollection& operator=(ThreadMonitorCollection const&);
+
+    virtual void do_calculateStatistics();
+    virtual void do_reset();
+    virtual void do_appendInfoSpaceItems(InfoSpaceItems&);
+    virtual void do_updateInfoSpaceItems();
+
+    const stor::utils::Duration_t updateInterval_;
+
+    ThreadMqMap threadMqMap_;
+    mutable boost::mutex threadsMutex_;
+
+    // The statistics of the calling thread
+    static boost::thread_specific_ptr<ThreadMQPtr> currentThread_;
+
+    xdata::Vector<xdata::String> threadNames_;
+    xdata::Vector<xdata::Double> threadCPUUsage_;          // fraction of one CPU
+    xdata::Vector<xdata::Double> threadVoluntarySwitches_; // Hz
+    xdata::Vector<xdata::Double> threadInvoluntarySwitches_; // Hz
+    std::vector<xdata::Vector<xdata::Double> > threadWaitTimes_; // fraction of time, indexed by WaitPoint
+  };
+
+
+  template<class Lock>
+  void ThreadMonitorCollection::lock(Lock& lock, const WaitPoint& waitPoint)
+  {
+    if ( lock.try_lock() ) return;
+
+    WaitTimer waitTimer(waitPoint);
+    lock.lock();
+  }
+
+} // namespace smproxy
+
+#endif // EventFilter_SMProxyServer_ThreadMonitorCollection_h
+
+
+/// emacs configuration
+/// Local Variables: -
+/// mode: c++ -
+/// c-basic-offset: 2 -
+/// indent-tabs-mode: nil -
+/// End: -
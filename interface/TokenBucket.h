@@ -0,0 +1,108 @@
+// $Id$
+/// @file: TokenBucket.h 
+
+#ifndef EventFilter_SMProxyServer_TokenBucket_h
+#define EventFilter_SMProxyServer_TokenBucket_h
+
+#include "EventFilter/StorageManager/interface/Utils.h"
+
+
+namespace smproxy {
+
+  /**
+   * A token bucket which is refilled at a constant rate up to
+   * a maximum depth. A bucket without rate is unlimited.
+   *
+   * The class is not thread-safe. The owner has to take care
+   * of any locking.
+   *
+   * $Author$
+   * $Revision$
+   * $Date$
+   */
+
+  class TokenBucket
+  {
+  public:
+
+    /**
+     * Create a bucket refilled with one token per given interval.
+     * A not_a_date_time or zero interval results in an unlimited bucket.
+     */
+    explicit TokenBucket
+    (
+      const stor::utils::Duration_t& interval = boost::posix_time::not_a_date_time,
+      const double depth = 1
+    );
+
+    /**
+     * Create a bucket refilled with the given number of tokens
+     * per second. A non-positive rate results in an unlimited bucket.
+     */
+    TokenBucket(const double tokensPerSecond, const double depth);
+
+    /**
+     * Return true if the requested tokens are available at the given time
+     */
+    bool hasTokens(const stor::utils::TimePoint_t&, const double tokens = 1);
+
+    /**
+     * Take the requested tokens from the bucket if they are available.
+     * Returns false if there are not enough tokens.
+     */
+    bool tryConsume(const stor::utils::TimePoint_t&, const double tokens = 1);
+
+    /**
+     * Take the given tokens from the bucket unconditionally.
+     * The bucket may go into debt, which is paid back by the refill.
+     */
+    void consume(const stor::utils::TimePoint_t&, const double tokens);
+
+    /**
+     * Return the time when the requested tokens will be available
+     */
+    stor::utils::TimePoint_t nextAvailable
+    (
+      const stor::utils::TimePoint_t&,
+      const double tokens = 1
+    );
+
+    /**
+     * Change the refill rate. The tokens already in the bucket are kept.
+     */
+    void setRate(const double tokensPerSecond);
+
+    /**
+     * Return the refill rate in tokens per second. 0 means unlimited.
+     */
+    double rate() const
+    { return rate_; }
+
+    /**
+     * Return true if the bucket does not limit the rate
+     */
+    bool unlimited() const
+    { return ( rate_ <= 0 ); }
+
+
+  private:
+
+    void refill(const stor::utils::TimePoint_t&);
+
+    double rate_;
+    double depth_;
+    double tokens_;
+    stor::utils::TimePoint_t lastRefill_;
+  };
+  
+} // namespace smproxy
+
+#endif // EventFilter_SMProxyServer_TokenBucket_h 
+
+
+/// emacs configuration
+/// Local Variables: -
+/// mode: c++ -
+/// c-basic-offset: 2 -
+/// indent-tabs-mode: nil -
+/// End: -
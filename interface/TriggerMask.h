@@ -0,0 +1,165 @@
+// $Id$
+/// @file: TriggerMask.h 
+
+#ifndef EventFilter_SMProxyServer_TriggerMask_h
+#define EventFilter_SMProxyServer_TriggerMask_h
+
+#include "IOPool/Streamer/interface/EventMessage.h"
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+
+namespace smproxy {
+
+  /**
+   * Precompiled HLT path selection of an event consumer.
+   *
+   * The selected paths are kept as a bitmask in 64-bit words, one bit
+   * per path in the order of the HLT trigger names of the INIT message.
+   * An event is tested against the selection with a word-wise AND of
+   * the mask and the paths which accepted the event. Only selections
+   * which are a plain OR of path names (optionally with wildcards)
+   * can be expressed as a mask. Any other selection accepts all events.
+   *
+   * $Author$
+   * $Revision$
+   * $Date$
+   */
+
+  class TriggerMask
+  {
+  public:
+
+    typedef std::vector<std::string> Strings;
+    typedef std::vector<uint64_t> Words;
+
+    /**
+     * Create a mask accepting all events
+     */
+    TriggerMask();
+
+    /**
+     * Return true if the trigger and event selection can be
+     * expressed as a TriggerMask.
+     */
+    static bool isSimple
+    (
+      const std::string& triggerSelection,
+      const Strings& eventSelection
+    );
+
+    /**
+     * Compile the trigger and event selection for the given
+     * HLT trigger names. A non-empty trigger selection takes
+     * precedence over the event selection.
+     */
+    void compile
+    (
+      const std::string& triggerSelection,
+      const Strings& eventSelection,
+      const Strings& hltTriggerNames
+    );
+
+    /**
+     * Fill the bitmask of HLT paths which accepted the given event
+     */
+    static void getAcceptedPaths(const EventMsgView&, Words& acceptedPaths);
+
+    /**
+     * Return true if the event with the given accepted paths is selected
+     */
+    bool accepts(const Words& acceptedPaths) const;
+
+    /**
+     * Return true if all events are accepted
+     */
+    bool acceptAll() const
+    { return acceptAll_; }
+
+    /**
+     * Return the bitmask of the selected paths
+     */
+    const Words& mask() const
+    { return mask_; }
+
+
+  private:
+
+    static bool getPathPatterns
+    (
+      const std::string& triggerSelection,
+      const Strings& eventSelection,
+      Strings& patterns
+    );
+    static bool isPathPattern(const std::string&);
+    static bool matches(const char* pattern, const char* name);
+
+    Words mask_;
+    bool acceptAll_;
+  };
+
+
+  /**
+   * The TriggerMasks of several consumers transposed into one bitmask
+   * of consumers per HLT path. An event is matched against all consumers
+   * at once by OR-ing the consumer bitmasks of the paths which accepted
+   * the event. Thus, the cost depends on the number of accepted paths
+   * instead of the number of consumers.
+   *
+   * $Author$
+   * $Revision$
+   * $Date$
+   */
+
+  class TriggerMaskSet
+  {
+  public:
+
+    typedef TriggerMask::Words Words;
+
+    TriggerMaskSet();
+
+    /**
+     * Forget all masks
+     */
+    void clear();
+
+    /**
+     * Add the mask of the next consumer. The consumers are numbered
+     * in the order they are added, starting at 0.
+     */
+    void add(const TriggerMask&);
+
+    /**
+     * Fill the bitmask of the consumers which select the event
+     * with the given accepted paths
+     */
+    void getAcceptingConsumers(const Words& acceptedPaths, Words& consumers) const;
+
+    /**
+     * Return true if the given consumer is set in the bitmask
+     */
+    static bool isSet(const Words& consumers, const size_t consumer)
+    { return ( consumers[consumer/64] >> (consumer%64) ) & 1; }
+
+
+  private:
+
+    size_t consumerCount_;
+    Words acceptAll_;
+    std::vector<Words> consumersByPath_;
+  };
+  
+} // namespace smproxy
+
+#endif // EventFilter_SMProxyServer_TriggerMask_h 
+
+
+/// emacs configuration
+/// Local Variables: -
+/// mode: c++ -
+/// c-basic-offset: 2 -
+/// indent-tabs-mode: nil -
+/// End: -
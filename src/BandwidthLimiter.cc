@@ -0,0 +1,259 @@
+// $Id$
+/// @file: BandwidthLimiter.cc
+
+#include "EventFilter/SMProxyServer/interface/BandwidthLimiter.h"
+#include "EventFilter/SMProxyServer/interface/ThreadMonitorCollection.h"
+
+#include <boost/thread/thread.hpp>
+
+#include <algorithm>
+
+
+namespace smproxy
+{
+  BandwidthLimiter::BandwidthLimiter() :
+  limit_(0),
+  limitPerSM_(0),
+  globalBucket_(0., 0.),
+  nextFlowId_(0)
+  {}
+
+
+  void BandwidthLimiter::setLimits
+  (
+    const double bytesPerSecond,
+    const double bytesPerSecondPerSM
+  )
+  {
+    boost::mutex::scoped_lock sl(mutex_);
+
+    limit_ = std::max(bytesPerSecond, 0.);
+    limitPerSM_ = std::max(bytesPerSecondPerSM, 0.);
+
+    // The buckets hold up to one second worth of data
+    globalBucket_ = TokenBucket(limit_, limit_);
+    smBuckets_.clear();
+
+    changed_.notify_all();
+  }
+
+
+  double BandwidthLimiter::limit() const
+  {
+    boost::mutex::scoped_lock sl(mutex_);
+    return limit_;
+  }
+
+
+  double BandwidthLimiter::limitPerSM() const
+  {
+    boost::mutex::scoped_lock sl(mutex_);
+    return limitPerSM_;
+  }
+
+
+  BandwidthLimiter::FlowID BandwidthLimiter::addFlow(const double weight)
+  {
+    boost::mutex::scoped_lock sl(mutex_);
+
+    Flow flow;
+    flow.weight = ( weight > 0 ) ? weight : 1;
+    flow.virtualTime = 0;
+    flow.waiting = false;
+    flow.expectedBytes = 0;
+    flow.reservedBytes = 0;
+    flow.lastCharge = stor::utils::getCurrentTime();
+    minWaitingVirtualTime(flow.virtualTime);
+
+    const FlowID flowId = nextFlowId_++;
+    flows_.insert(Flows::value_type(flowId, flow));
+    return flowId;
+  }
+
+
+  void BandwidthLimiter::removeFlow(const FlowID& flowId)
+  {
+    boost::mutex::scoped_lock sl(mutex_);
+    flows_.erase(flowId);
+    changed_.notify_all();
+  }
+
+
+  void BandwidthLimiter::acquire
+  (
+    const FlowID& flowId,
+    const std::string& sourceURL
+  )
+  {
+    boost::mutex::scoped_lock sl(mutex_);
+
+    if ( unlimited() ) return;
+
+    Flows::iterator pos = flows_.find(flowId);
+    if ( pos == flows_.end() ) return;
+
+    // A flow which was idle does not get credit for the bandwidth
+    // it did not use. Otherwise, it would lock out the others.
+    double minVirtualTime;
+    if ( stor::utils::getCurrentTime() - pos->second.lastCharge > boost::posix_time::seconds(1) &&
+      minWaitingVirtualTime(minVirtualTime) )
+      pos->second.virtualTime = std::max(pos->second.virtualTime, minVirtualTime);
+
+    pos->second.waiting = true;
+    pos->second.sourceURL = sourceURL;
+
+    // Readiness of other flows changes with time, too.
+    // Thus, do not wait longer than this for a notification.
+    const stor::utils::Duration_t maxWait = boost::posix_time::milliseconds(10);
+    ThreadMonitorCollection::WaitTimer waitTimer(ThreadMonitorCollection::THROTTLE_WAIT);
+
+    try
+    {
+      while ( ! unlimited() )
+      {
+        const stor::utils::TimePoint_t now = stor::utils::getCurrentTime();
+        stor::utils::TimePoint_t readyTime;
+
+        if ( ready(pos->second, now, readyTime) )
+        {
+          if ( hasPrecedence(pos, now) ) break;
+          readyTime = now + maxWait;
+        }
+        changed_.timed_wait(sl, std::min(readyTime, now + maxWait));
+      }
+    }
+    catch (boost::thread_interrupted&)
+    {
+      pos->second.waiting = false;
+      changed_.notify_all();
+      throw;
+    }
+
+    pos->second.waiting = false;
+
+    // Other flows have to wait until the reservation has been paid back
+    pos->second.reservedBytes = pos->second.expectedBytes;
+    consume(pos->second, sourceURL, pos->second.reservedBytes);
+  }
+
+
+  void BandwidthLimiter::charge
+  (
+    const FlowID& flowId,
+    const std::string& sourceURL,
+    const size_t bytes
+  )
+  {
+    boost::mutex::scoped_lock sl(mutex_);
+
+    if ( unlimited() ) return;
+
+    Flows::iterator pos = flows_.find(flowId);
+    if ( pos == flows_.end() ) return;
+
+    consume(pos->second, sourceURL,
+      static_cast<double>(bytes) - static_cast<double>(pos->second.reservedBytes));
+
+    // An empty reply does not change the expected event size
+    if ( bytes > 0 ) pos->second.expectedBytes = bytes;
+    pos->second.reservedBytes = 0;
+    pos->second.lastCharge = stor::utils::getCurrentTime();
+
+    changed_.notify_all();
+  }
+
+
+  void BandwidthLimiter::consume
+  (
+    Flow& flow,
+    const std::string& sourceURL,
+    const double bytes
+  )
+  {
+    const stor::utils::TimePoint_t now = stor::utils::getCurrentTime();
+    globalBucket_.consume(now, bytes);
+    getSMBucket(sourceURL).consume(now, bytes);
+    flow.virtualTime += bytes / flow.weight;
+  }
+
+
+  bool BandwidthLimiter::unlimited() const
+  {
+    return ( limit_ <= 0 && limitPerSM_ <= 0 );
+  }
+
+
+  TokenBucket& BandwidthLimiter::getSMBucket(const std::string& sourceURL)
+  {
+    SMBuckets::iterator pos = smBuckets_.lower_bound(sourceURL);
+    if ( pos == smBuckets_.end() || smBuckets_.key_comp()(sourceURL, pos->first) )
+    {
+      pos = smBuckets_.insert(pos,
+        SMBuckets::value_type(sourceURL, TokenBucket(limitPerSM_, limitPerSM_)));
+    }
+    return pos->second;
+  }
+
+
+  bool BandwidthLimiter::ready
+  (
+    const Flow& flow,
+    const stor::utils::TimePoint_t& now,
+    stor::utils::TimePoint_t& readyTime
+  )
+  {
+    // A flow may go ahead as long as the buckets are not in debt
+    readyTime = std::max(
+      globalBucket_.nextAvailable(now, 0),
+      getSMBucket(flow.sourceURL).nextAvailable(now, 0)
+    );
+    return ( readyTime <= now );
+  }
+
+
+  bool BandwidthLimiter::hasPrecedence
+  (
+    const Flows::const_iterator& flow,
+    const stor::utils::TimePoint_t& now
+  )
+  {
+    stor::utils::TimePoint_t readyTime;
+
+    for (Flows::const_iterator it = flows_.begin(), itEnd = flows_.end();
+         it != itEnd; ++it)
+    {
+      if ( it == flow || ! it->second.waiting ) continue;
+
+      if ( it->second.virtualTime < flow->second.virtualTime &&
+        ready(it->second, now, readyTime) )
+        return false;
+    }
+    return true;
+  }
+
+
+  bool BandwidthLimiter::minWaitingVirtualTime(double& virtualTime) const
+  {
+    bool found = false;
+
+    for (Flows::const_iterator it = flows_.begin(), itEnd = flows_.end();
+         it != itEnd; ++it)
+    {
+      if ( ! it->second.waiting ) continue;
+
+      if ( ! found || it->second.virtualTime < virtualTime )
+        virtualTime = it->second.virtualTime;
+      found = true;
+    }
+    return found;
+  }
+
+} // namespace smproxy
+
+
+/// emacs configuration
+/// Local Variables: -
+/// mode: c++ -
+/// c-basic-offset: 2 -
+/// indent-tabs-mode: nil -
+/// End: -
@@ -0,0 +1,130 @@
+// $Id$
+/// @file: Checksum.cc
+
+#include "EventFilter/SMProxyServer/interface/Checksum.h"
+#include "FWCore/Utilities/interface/Adler32Calculator.h"
+
+#include <algorithm>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+
+namespace
+{
+  const uint32_t adlerBase = 65521;
+
+  // Largest number of bytes which can be summed up before the
+  // sums have to be reduced modulo the base to avoid overflows.
+  // It is a multiple of the 16 bytes handled per SSE2 step.
+  const size_t adlerMaxBlock = 5552;
+
+#ifdef __SSE2__
+  void adler32SSE2
+  (
+    const unsigned char* data,
+    size_t length,
+    uint32_t& a,
+    uint32_t& b
+  )
+  {
+    const __m128i zero = _mm_setzero_si128();
+    // Byte i of a 16 byte block is added (16-i) times to b
+    const __m128i weightsLow = _mm_set_epi16(9, 10, 11, 12, 13, 14, 15, 16);
+    const __m128i weightsHigh = _mm_set_epi16(1, 2, 3, 4, 5, 6, 7, 8);
+
+    while ( length >= 16 )
+    {
+      size_t blocks = std::min(length, adlerMaxBlock) / 16;
+      length -= blocks * 16;
+
+      // b receives a as it was before each block 16 times
+      uint64_t sumB = static_cast<uint64_t>(a) * blocks * 16;
+
+      __m128i byteSum = zero;    // sum of all bytes so far
+      __m128i prefixSum = zero;  // sum of byteSum before each block
+      __m128i weightedSum = zero;
+
+      do
+      {
+        const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data));
+        data += 16;
+
+        prefixSum = _mm_add_epi64(prefixSum, byteSum);
+        byteSum = _mm_add_epi64(byteSum, _mm_sad_epu8(block, zero));
+
+        weightedSum = _mm_add_epi32(weightedSum,
+          _mm_madd_epi16(_mm_unpacklo_epi8(block, zero), weightsLow));
+        weightedSum = _mm_add_epi32(weightedSum,
+          _mm_madd_epi16(_mm_unpackhi_epi8(block, zero), weightsHigh));
+      }
+      while ( --blocks );
+
+      uint64_t bytes[2], prefixes[2];
+      uint32_t weights[4];
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(bytes), byteSum);
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(prefixes), prefixSum);
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(weights), weightedSum);
+
+      sumB += 16 * (prefixes[0] + prefixes[1]);
+      sumB += static_cast<uint64_t>(weights[0]) + weights[1] + weights[2] + weights[3];
+
+      b = static_cast<uint32_t>( (b + sumB) % adlerBase );
+      a = static_cast<uint32_t>( (a + bytes[0] + bytes[1]) % adlerBase );
+    }
+
+    // The remaining bytes are less than one block
+    while ( length-- )
+    {
+      a += *data++;
+      b += a;
+    }
+    a %= adlerBase;
+    b %= adlerBase;
+  }
+#endif
+}
+
+
+namespace smproxy
+{
+  uint32_t adler32(const unsigned char* data, const size_t length)
+  {
+    uint32_t a = 1;
+    uint32_t b = 0;
+#ifdef __SSE2__
+    adler32SSE2(data, length, a, b);
+#else
+    cms::Adler32(reinterpret_cast<const char*>(data), length, a, b);
+#endif
+    return (b << 16) | a;
+  }
+
+
+  bool hasValidChecksum(const EventMsgView& view)
+  {
+    const uint32_t checksum = view.adler32_chksum();
+    if ( checksum == 0 ) return true;
+
+    return ( adler32(view.eventData(), view.eventLength()) == checksum );
+  }
+
+
+  bool hasValidChecksum(const DQMEventMsgView& view)
+  {
+    const uint32_t checksum = view.adler32_chksum();
+    if ( checksum == 0 ) return true;
+
+    return ( adler32(view.eventAddress(), view.eventLength()) == checksum );
+  }
+
+} // namespace smproxy
+
+
+/// emacs configuration
+/// Local Variables: -
+/// mode: c++ -
+/// c-basic-offset: 2 -
+/// indent-tabs-mode: nil -
+/// End: -
@@ -4,6 +4,7 @@
 #include "EventFilter/SMProxyServer/interface/Configuration.h"
 
 #include <toolbox/net/Utils.h>
+#include <xdata/ItemEvent.h>
 
 #include <sstream>
 
@@ -24,6 +25,7 @@ namespace smproxy
     setDQMArchivingDefaults();
     setQueueConfigurationDefaults();
     setAlarmDefaults();
+    setThreadAffinityDefaults();
 
     setupDataRetrieverInfoSpaceParams(infoSpace);
     setupEventServingInfoSpaceParams(infoSpace);
@@ -31,42 +33,39 @@ namespace smproxy
     setupDQMArchivingInfoSpaceParams(infoSpace);
     setupQueueConfigurationInfoSpaceParams(infoSpace);
     setupAlarmInfoSpaceParams(infoSpace);
-  }
+    setupThreadAffinityInfoSpaceParams(infoSpace);
 
-  struct DataRetrieverParams Configuration::getDataRetrieverParams() const
-  {
-    boost::mutex::scoped_lock sl(generalMutex_);
-    return dataRetrieverParamCopy_;
+    publishSnapshot();
   }
 
   struct stor::EventServingParams Configuration::getEventServingParams() const
   {
-    boost::mutex::scoped_lock sl(generalMutex_);
-    return eventServeParamCopy_;
+    return getSnapshot()->eventServeParams_;
   }
 
   struct stor::DQMProcessingParams Configuration::getDQMProcessingParams() const
   {
-    boost::mutex::scoped_lock sl(generalMutex_);
-    return dqmProcessingParamCopy_;
+    return getSnapshot()->dqmProcessingParams_;
   }
 
   struct DQMArchivingParams Configuration::getDQMArchivingParams() const
   {
-    boost::mutex::scoped_lock sl(generalMutex_);
-    return dqmArchivingParamCopy_;
+    return getSnapshot()->dqmArchivingParams_;
   }
 
   struct QueueConfigurationParams Configuration::getQueueConfigurationParams() const
   {
-    boost::mutex::scoped_lock sl(generalMutex_);
-    return queueConfigParamCopy_;
+    return getSnapshot()->queueConfigParams_;
   }
   
   struct AlarmParams Configuration::getAlarmParams() const
   {
-    boost::mutex::scoped_lock sl(generalMutex_);
-    return alarmParamCopy_;
+    return getSnapshot()->alarmParams_;
+  }
+
+  struct ThreadAffinityParams Configuration::getThreadAffinityParams() const
+  {
+    return getSnapshot()->threadAffinityParams_;
   }
   
   void Configuration::updateAllParams()
@@ -78,6 +77,26 @@ namespace smproxy
     updateLocalDQMArchivingData();
     updateLocalQueueConfigurationData();
     updateLocalAlarmData();
+    updateLocalThreadAffinityData();
+    publishSnapshot();
+  }
+
+  void Configuration::publishSnapshot()
+  {
+    // the caller holds the generalMutex_ (or is the constructor)
+    const uint32_t version = snapshot_ ? snapshot_->version_ + 1 : 1;
+
+    boost::shared_ptr<ConfigurationSnapshot> snapshot(new ConfigurationSnapshot());
+    snapshot->version_ = version;
+    snapshot->dataRetrieverParams_ = dataRetrieverParamCopy_;
+    snapshot->eventServeParams_ = eventServeParamCopy_;
+    snapshot->dqmProcessingParams_ = dqmProcessingParamCopy_;
+    snapshot->dqmArchivingParams_ = dqmArchivingParamCopy_;
+    snapshot->queueConfigParams_ = queueConfigParamCopy_;
+    snapshot->alarmParams_ = alarmParamCopy_;
+    snapshot->threadAffinityParams_ = threadAffinityParamCopy_;
+
+    boost::atomic_store(&snapshot_, ConfigurationSnapshotPtr(snapshot));
   }
 
   void Configuration::setDataRetrieverDefaults(unsigned long instanceNumber)
@@ -87,10 +106,27 @@ namespace smproxy
     dataRetrieverParamCopy_.allowMissingSM_ = true;
     dataRetrieverParamCopy_.maxConnectionRetries_ = 5;
     dataRetrieverParamCopy_.connectTrySleepTime_ = 10;
+    dataRetrieverParamCopy_.maxConnectTrySleepTime_ = 300;
     dataRetrieverParamCopy_.headerRetryInterval_ = 5;
     dataRetrieverParamCopy_.retryInterval_ = 1;
     dataRetrieverParamCopy_.sleepTimeIfIdle_ =
       boost::posix_time::milliseconds(100);
+    dataRetrieverParamCopy_.routeByTriggerBits_ = false;
+    dataRetrieverParamCopy_.pipelineQueueDepth_ = 8;
+    dataRetrieverParamCopy_.spoolDirectory_ = "";
+    dataRetrieverParamCopy_.spoolSizeMB_ = 1024;
+    dataRetrieverParamCopy_.spoolReplayWindow_ = boost::posix_time::seconds(60);
+    dataRetrieverParamCopy_.captureDirectory_ = "";
+    dataRetrieverParamCopy_.captureSizeMB_ = 2048;
+    dataRetrieverParamCopy_.prewarmOutputModules_.clear();
+    dataRetrieverParamCopy_.warmRestart_ = false;
+    dataRetrieverParamCopy_.stopTimeout_ = boost::posix_time::seconds(10);
+    dataRetrieverParamCopy_.highPriorityConsumers_.clear();
+    dataRetrieverParamCopy_.lowPriorityConsumers_.clear();
+    dataRetrieverParamCopy_.maxBandwidth_ = 0;
+    dataRetrieverParamCopy_.maxBandwidthPerSM_ = 0;
+    dataRetrieverParamCopy_.verifyChecksums_ = true;
+    dataRetrieverParamCopy_.maxRequestsPerSM_ = 0;
 
     std::string tmpString(toolbox::net::getHostName());
     // strip domainame
@@ -131,6 +167,7 @@ namespace smproxy
   void Configuration::setQueueConfigurationDefaults()
   {
     queueConfigParamCopy_.registrationQueueSize_ = 128;
+    queueConfigParamCopy_.registrationQueueMaxSize_ = 4096;
     queueConfigParamCopy_.monitoringSleepSec_ = boost::posix_time::seconds(1);
   }
 
@@ -140,6 +177,15 @@ namespace smproxy
     alarmParamCopy_.sendAlarms_ = true;
     alarmParamCopy_.corruptedEventRate_ = 0.1;
   }
+
+  void Configuration::setThreadAffinityDefaults()
+  {
+    // leave the placement of the threads to the scheduler
+    threadAffinityParamCopy_.retrieverCPUs_ = "";
+    threadAffinityParamCopy_.dataManagerCPUs_ = "";
+    threadAffinityParamCopy_.archiverCPUs_ = "";
+    threadAffinityParamCopy_.monitoringCPUs_ = "";
+  }
   
   void Configuration::
   setupDataRetrieverInfoSpaceParams(xdata::InfoSpace* infoSpace)
@@ -149,18 +195,55 @@ namespace smproxy
     allowMissingSM_ = dataRetrieverParamCopy_.allowMissingSM_;
     maxConnectionRetries_ = dataRetrieverParamCopy_.maxConnectionRetries_;
     connectTrySleepTime_ = dataRetrieverParamCopy_.connectTrySleepTime_;
+    maxConnectTrySleepTime_ = dataRetrieverParamCopy_.maxConnectTrySleepTime_;
     headerRetryInterval_ = dataRetrieverParamCopy_.headerRetryInterval_;
     retryInterval_ = dataRetrieverParamCopy_.retryInterval_;
     sleepTimeIfIdle_ = dataRetrieverParamCopy_.sleepTimeIfIdle_.total_milliseconds();
+    routeByTriggerBits_ = dataRetrieverParamCopy_.routeByTriggerBits_;
+    pipelineQueueDepth_ = dataRetrieverParamCopy_.pipelineQueueDepth_;
+    spoolDirectory_ = dataRetrieverParamCopy_.spoolDirectory_;
+    spoolSizeMB_ = dataRetrieverParamCopy_.spoolSizeMB_;
+    spoolReplayWindow_ = dataRetrieverParamCopy_.spoolReplayWindow_.total_seconds();
+    captureDirectory_ = dataRetrieverParamCopy_.captureDirectory_;
+    captureSizeMB_ = dataRetrieverParamCopy_.captureSizeMB_;
+    stor::utils::getXdataVector(dataRetrieverParamCopy_.prewarmOutputModules_, prewarmOutputModules_);
+    warmRestart_ = dataRetrieverParamCopy_.warmRestart_;
+    stopTimeout_ = dataRetrieverParamCopy_.stopTimeout_.total_seconds();
+    stor::utils::getXdataVector(dataRetrieverParamCopy_.highPriorityConsumers_, highPriorityConsumers_);
+    stor::utils::getXdataVector(dataRetrieverParamCopy_.lowPriorityConsumers_, lowPriorityConsumers_);
+    maxBandwidth_ = dataRetrieverParamCopy_.maxBandwidth_;
+    maxBandwidthPerSM_ = dataRetrieverParamCopy_.maxBandwidthPerSM_;
+    verifyChecksums_ = dataRetrieverParamCopy_.verifyChecksums_;
+    maxRequestsPerSM_ = dataRetrieverParamCopy_.maxRequestsPerSM_;
 
     // bind the local xdata variables to the infospace
     infoSpace->fireItemAvailable("SMRegistrationList", &smRegistrationList_);
     infoSpace->fireItemAvailable("allowMissingSM", &allowMissingSM_);
     infoSpace->fireItemAvailable("maxConnectionRetries", &maxConnectionRetries_);
     infoSpace->fireItemAvailable("connectTrySleepTime", &connectTrySleepTime_);
+    infoSpace->fireItemAvailable("maxConnectTrySleepTime", &maxConnectTrySleepTime_);
     infoSpace->fireItemAvailable("headerRetryInterval", &headerRetryInterval_);
     infoSpace->fireItemAvailable("retryInterval", &retryInterval_);
     infoSpace->fireItemAvailable("sleepTimeIfIdle", &sleepTimeIfIdle_);
+    infoSpace->fireItemAvailable("routeByTriggerBits", &routeByTriggerBits_);
+    infoSpace->fireItemAvailable("pipelineQueueDepth", &pipelineQueueDepth_);
+    infoSpace->fireItemAvailable("spoolDirectory", &spoolDirectory_);
+    infoSpace->fireItemAvailable("spoolSizeMB", &spoolSizeMB_);
+    infoSpace->fireItemAvailable("spoolReplayWindow", &spoolReplayWindow_);
+    infoSpace->fireItemAvailable("captureDirectory", &captureDirectory_);
+    infoSpace->fireItemAvailable("captureSizeMB", &captureSizeMB_);
+    infoSpace->fireItemAvailable("prewarmOutputModules", &prewarmOutputModules_);
+    infoSpace->fireItemAvailable("warmRestart", &warmRestart_);
+    infoSpace->fireItemAvailable("stopTimeout", &stopTimeout_);
+    infoSpace->fireItemAvailable("highPriorityConsumers", &highPriorityConsumers_);
+    infoSpace->fireItemAvailable("lowPriorityConsumers", &lowPriorityConsumers_);
+    infoSpace->fireItemAvailable("maxBandwidth", &maxBandwidth_);
+    infoSpace->fireItemAvailable("maxBandwidthPerSM", &maxBandwidthPerSM_);
+    infoSpace->fireItemAvailable("verifyChecksums", &verifyChecksums_);
+    infoSpace->fireItemAvailable("maxRequestsPerSM", &maxRequestsPerSM_);
+
+    // watch the SM list to add or remove SMs without a reconfiguration
+    infoSpace->addItemChangedListener("SMRegistrationList", this);
   }
   
   void Configuration::
@@ -220,11 +303,13 @@ namespace smproxy
   {
     // copy the initial defaults to the xdata variables
     registrationQueueSize_ = queueConfigParamCopy_.registrationQueueSize_;
+    registrationQueueMaxSize_ = queueConfigParamCopy_.registrationQueueMaxSize_;
     monitoringSleepSec_ =
       stor::utils::durationToSeconds(queueConfigParamCopy_.monitoringSleepSec_);
     
     // bind the local xdata variables to the infospace
     infoSpace->fireItemAvailable("registrationQueueSize", &registrationQueueSize_);
+    infoSpace->fireItemAvailable("registrationQueueMaxSize", &registrationQueueMaxSize_);
     infoSpace->fireItemAvailable("monitoringSleepSec", &monitoringSleepSec_);
   }
   
@@ -239,6 +324,22 @@ namespace smproxy
     infoSpace->fireItemAvailable("sendAlarms", &sendAlarms_);
     infoSpace->fireItemAvailable("corruptedEventRate", &corruptedEventRate_);
   }
+  
+  void Configuration::
+  setupThreadAffinityInfoSpaceParams(xdata::InfoSpace* infoSpace)
+  {
+    // copy the initial defaults to the xdata variables
+    retrieverCPUs_ = threadAffinityParamCopy_.retrieverCPUs_;
+    dataManagerCPUs_ = threadAffinityParamCopy_.dataManagerCPUs_;
+    archiverCPUs_ = threadAffinityParamCopy_.archiverCPUs_;
+    monitoringCPUs_ = threadAffinityParamCopy_.monitoringCPUs_;
+ 
+    // bind the local xdata variables to the infospace
+    infoSpace->fireItemAvailable("retrieverCPUs", &retrieverCPUs_);
+    infoSpace->fireItemAvailable("dataManagerCPUs", &dataManagerCPUs_);
+    infoSpace->fireItemAvailable("archiverCPUs", &archiverCPUs_);
+    infoSpace->fireItemAvailable("monitoringCPUs", &monitoringCPUs_);
+  }
 
   void Configuration::updateLocalDataRetrieverData()
   {
@@ -246,10 +347,29 @@ namespace smproxy
     dataRetrieverParamCopy_.allowMissingSM_ = allowMissingSM_;
     dataRetrieverParamCopy_.maxConnectionRetries_ = maxConnectionRetries_;
     dataRetrieverParamCopy_.connectTrySleepTime_ = connectTrySleepTime_;
+    dataRetrieverParamCopy_.maxConnectTrySleepTime_ = maxConnectTrySleepTime_;
     dataRetrieverParamCopy_.headerRetryInterval_ = headerRetryInterval_;
     dataRetrieverParamCopy_.retryInterval_ = retryInterval_;
     dataRetrieverParamCopy_.sleepTimeIfIdle_ =
       boost::posix_time::milliseconds(sleepTimeIfIdle_);
+    dataRetrieverParamCopy_.routeByTriggerBits_ = routeByTriggerBits_;
+    dataRetrieverParamCopy_.pipelineQueueDepth_ = pipelineQueueDepth_;
+    dataRetrieverParamCopy_.spoolDirectory_ = spoolDirectory_;
+    dataRetrieverParamCopy_.spoolSizeMB_ = spoolSizeMB_;
+    dataRetrieverParamCopy_.spoolReplayWindow_ =
+      boost::posix_time::seconds(spoolReplayWindow_);
+    dataRetrieverParamCopy_.captureDirectory_ = captureDirectory_;
+    dataRetrieverParamCopy_.captureSizeMB_ = captureSizeMB_;
+    stor::utils::getStdVector(prewarmOutputModules_, dataRetrieverParamCopy_.prewarmOutputModules_);
+    dataRetrieverParamCopy_.warmRestart_ = warmRestart_;
+    dataRetrieverParamCopy_.stopTimeout_ =
+      boost::posix_time::seconds(stopTimeout_);
+    stor::utils::getStdVector(highPriorityConsumers_, dataRetrieverParamCopy_.highPriorityConsumers_);
+    stor::utils::getStdVector(lowPriorityConsumers_, dataRetrieverParamCopy_.lowPriorityConsumers_);
+    dataRetrieverParamCopy_.maxBandwidth_ = maxBandwidth_;
+    dataRetrieverParamCopy_.maxBandwidthPerSM_ = maxBandwidthPerSM_;
+    dataRetrieverParamCopy_.verifyChecksums_ = verifyChecksums_;
+    dataRetrieverParamCopy_.maxRequestsPerSM_ = maxRequestsPerSM_;
   }
 
   void Configuration::updateLocalEventServingData()
@@ -294,6 +414,7 @@ namespace smproxy
   void Configuration::updateLocalQueueConfigurationData()
   {
     queueConfigParamCopy_.registrationQueueSize_ = registrationQueueSize_;
+    queueConfigParamCopy_.registrationQueueMaxSize_ = registrationQueueMaxSize_;
     queueConfigParamCopy_.monitoringSleepSec_ =
       stor::utils::secondsToDuration(monitoringSleepSec_);
   }
@@ -303,10 +424,32 @@ namespace smproxy
     alarmParamCopy_.sendAlarms_ = sendAlarms_;
     alarmParamCopy_.corruptedEventRate_ = corruptedEventRate_;
   }
+
+  void Configuration::updateLocalThreadAffinityData()
+  {
+    threadAffinityParamCopy_.retrieverCPUs_ = retrieverCPUs_;
+    threadAffinityParamCopy_.dataManagerCPUs_ = dataManagerCPUs_;
+    threadAffinityParamCopy_.archiverCPUs_ = archiverCPUs_;
+    threadAffinityParamCopy_.monitoringCPUs_ = monitoringCPUs_;
+  }
   
   void Configuration::actionPerformed(xdata::Event& ispaceEvent)
   {
     boost::mutex::scoped_lock sl(generalMutex_);
+
+    if (ispaceEvent.type() == "ItemChangedEvent")
+    {
+      std::string item =
+        dynamic_cast<xdata::ItemChangedEvent&>(ispaceEvent).itemName();
+      if (item == "SMRegistrationList")
+      {
+        // The running event retrievers pick up the new list
+        // on their next reconnect attempt
+        stor::utils::getStdVector(smRegistrationList_,
+          dataRetrieverParamCopy_.smRegistrationList_);
+        publishSnapshot();
+      }
+    }
   }
 
 } // namespace smproxy
@@ -0,0 +1,183 @@
+// $Id$
+/// @file: ConsumerExpiryWheel.cc
+
+#include "EventFilter/SMProxyServer/interface/ConsumerExpiryWheel.h"
+
+#include <algorithm>
+
+
+namespace smproxy
+{
+  ConsumerExpiryWheel::ConsumerExpiryWheel
+  (
+    const stor::utils::Duration_t& resolution,
+    const stor::utils::TimePoint_t& now
+  ) :
+  resolution_(resolution),
+  startTime_(now),
+  currentTick_(0),
+  nextGeneration_(0)
+  {}
+
+
+  void ConsumerExpiryWheel::schedule
+  (
+    const stor::QueueID& queueId,
+    const stor::utils::TimePoint_t& deadline
+  )
+  {
+    const uint64_t tick = toTick(deadline, true);
+
+    Entries::iterator pos = entries_.find(queueId);
+    if ( pos == entries_.end() )
+    {
+      Entry entry;
+      entry.deadlineTick = tick;
+      entry.slotTick = 0;
+      entry.generation = 0;
+      pos = entries_.insert(Entries::value_type(queueId, entry)).first;
+      insert(pos, currentTick_ + 1);
+    }
+    else
+    {
+      // A later deadline is picked up when the current slot is due
+      const bool earlier = ( tick < pos->second.slotTick );
+      pos->second.deadlineTick = tick;
+      if ( earlier ) insert(pos, currentTick_ + 1);
+    }
+  }
+
+
+  void ConsumerExpiryWheel::cancel(const stor::QueueID& queueId)
+  {
+    entries_.erase(queueId);
+  }
+
+
+  void ConsumerExpiryWheel::expire
+  (
+    const stor::utils::TimePoint_t& now,
+    stor::QueueIDs& expired
+  )
+  {
+    const uint64_t nowTick = toTick(now, false);
+
+    if ( entries_.empty() && currentTick_ < nowTick )
+    {
+      // Nothing to expire. Skip the idle time at once.
+      clear();
+      currentTick_ = nowTick;
+      return;
+    }
+
+    while ( currentTick_ < nowTick )
+    {
+      ++currentTick_;
+
+      // Move the queues of the higher level slots which are
+      // due into the finer grained slots of the lower levels
+      for ( size_t level = LEVELS - 1; level > 0; --level )
+      {
+        if ( currentTick_ & ((uint64_t(1) << (SLOT_BITS*level)) - 1) ) continue;
+
+        Slot slot;
+        slot.swap(slots_[level][(currentTick_ >> (SLOT_BITS*level)) & (SLOTS-1)]);
+        for ( Slot::const_iterator it = slot.begin(), itEnd = slot.end();
+              it != itEnd; ++it )
+        {
+          Entries::iterator pos = entries_.find(it->first);
+          if ( pos == entries_.end() || pos->second.generation != it->second ) continue;
+          insert(pos, currentTick_);
+        }
+      }
+
+      Slot slot;
+      slot.swap(slots_[0][currentTick_ & (SLOTS-1)]);
+      for ( Slot::const_iterator it = slot.begin(), itEnd = slot.end();
+            it != itEnd; ++it )
+      {
+        Entries::iterator pos = entries_.find(it->first);
+        if ( pos == entries_.end() || pos->second.generation != it->second ) continue;
+
+        if ( pos->second.deadlineTick > currentTick_ )
+        {
+          // The deadline has been moved since the queue was inserted
+          insert(pos, currentTick_ + 1);
+        }
+        else
+        {
+          expired.push_back(pos->first);
+          entries_.erase(pos);
+        }
+      }
+    }
+  }
+
+
+  void ConsumerExpiryWheel::clear()
+  {
+    entries_.clear();
+    for ( size_t level = 0; level < LEVELS; ++level )
+    {
+      for ( size_t i = 0; i < SLOTS; ++i )
+        Slot().swap(slots_[level][i]);
+    }
+  }
+
+
+  uint64_t ConsumerExpiryWheel::toTick
+  (
+    const stor::utils::TimePoint_t& time,
+    const bool roundUp
+  ) const
+  {
+    if ( time <= startTime_ ) return 0;
+
+    // Deadlines are rounded up and the current time is rounded down.
+    // Thus, a queue never expires before its deadline.
+    const uint64_t resolution = resolution_.total_microseconds() > 0 ?
+      resolution_.total_microseconds() : 1;
+    const uint64_t elapsed = (time - startTime_).total_microseconds();
+    return ( roundUp ? elapsed + resolution - 1 : elapsed ) / resolution;
+  }
+
+
+  void ConsumerExpiryWheel::insert
+  (
+    Entries::iterator pos,
+    const uint64_t earliestTick
+  )
+  {
+    uint64_t tick = std::max(pos->second.deadlineTick, earliestTick);
+
+    // Use the finest level on which the slot of the tick is less
+    // than a full turn ahead of the current slot of that level
+    size_t level = 0;
+    while ( level < LEVELS &&
+      (tick >> (SLOT_BITS*level)) - (currentTick_ >> (SLOT_BITS*level)) >= SLOTS )
+      ++level;
+
+    if ( level == LEVELS )
+    {
+      // Beyond the range of the wheel. Park the queue in the farthest
+      // slot of the top level. It is moved again once this slot is due.
+      level = LEVELS - 1;
+      tick = ((currentTick_ >> (SLOT_BITS*level)) + SLOTS - 1) << (SLOT_BITS*level);
+    }
+
+    pos->second.slotTick = tick;
+    pos->second.generation = ++nextGeneration_;
+    slots_[level][(tick >> (SLOT_BITS*level)) & (SLOTS-1)].push_back(
+      std::make_pair(pos->first, pos->second.generation)
+    );
+  }
+
+} // namespace smproxy
+
+
+/// emacs configuration
+/// Local Variables: -
+/// mode: c++ -
+/// c-basic-offset: 2 -
+/// indent-tabs-mode: nil -
+/// End: -
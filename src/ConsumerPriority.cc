@@ -0,0 +1,119 @@
+// $Id$
+/// @file: ConsumerPriority.cc
+
+#include "EventFilter/SMProxyServer/interface/ConsumerPriority.h"
+#include "EventFilter/StorageManager/interface/DQMEventConsumerRegistrationInfo.h"
+
+#include <boost/pointer_cast.hpp>
+
+#include <errno.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+
+namespace
+{
+  bool matches
+  (
+    const stor::RegPtr regPtr,
+    const smproxy::DataRetrieverParams::ConsumerPatterns& patterns
+  )
+  {
+    for (smproxy::DataRetrieverParams::ConsumerPatterns::const_iterator
+           it = patterns.begin(), itEnd = patterns.end(); it != itEnd; ++it)
+    {
+      if ( it->empty() ) continue;
+      if ( regPtr->consumerName().find(*it) != std::string::npos ||
+        regPtr->remoteHost().find(*it) != std::string::npos )
+        return true;
+    }
+    return false;
+  }
+
+  // The nice value is a per-thread attribute on Linux
+  pid_t threadId()
+  {
+    return static_cast<pid_t>( syscall(SYS_gettid) );
+  }
+}
+
+
+namespace smproxy
+{
+  ConsumerPriority getConsumerPriority
+  (
+    const stor::RegPtr regPtr,
+    DataRetrieverParams const& drp
+  )
+  {
+    if ( matches(regPtr, drp.highPriorityConsumers_) ) return HIGH_PRIORITY;
+    if ( matches(regPtr, drp.lowPriorityConsumers_) ) return LOW_PRIORITY;
+
+    // DQM clients shall never starve
+    if ( boost::dynamic_pointer_cast<stor::DQMEventConsumerRegistrationInfo>(regPtr) )
+      return HIGH_PRIORITY;
+
+    return NORMAL_PRIORITY;
+  }
+
+
+  double getBandwidthWeight(const ConsumerPriority& priority)
+  {
+    static const double weight[PRIORITY_CLASSES] = { 4, 2, 1 };
+
+    if ( priority >= PRIORITY_CLASSES ) return 1;
+    return weight[priority];
+  }
+
+
+  void setThreadPriority(const ConsumerPriority& priority, const int baseNice)
+  {
+    // Without privileges, the nice value can only be raised.
+    // Thus, the high priority class keeps the base value.
+    static const int niceIncrement[PRIORITY_CLASSES] = { 0, 5, 10 };
+
+    if ( priority >= PRIORITY_CLASSES || niceIncrement[priority] == 0 ) return;
+
+    // Failing to renice only costs the scheduling preference
+    setpriority(PRIO_PROCESS, threadId(), baseNice + niceIncrement[priority]);
+  }
+
+
+  int getThreadNice()
+  {
+    errno = 0;
+    const int nice = getpriority(PRIO_PROCESS, threadId());
+    return ( errno == 0 ) ? nice : 0;
+  }
+
+
+  std::ostream& operator<<(std::ostream& os, const ConsumerPriority& priority)
+  {
+    switch (priority)
+    {
+      case HIGH_PRIORITY:
+        os << "High";
+        break;
+      case NORMAL_PRIORITY:
+        os << "Normal";
+        break;
+      case LOW_PRIORITY:
+        os << "Low";
+        break;
+      default:
+        os << "Unknown";
+        break;
+    }
+    return os;
+  }
+
+} // namespace smproxy
+
+
+/// emacs configuration
+/// Local Variables: -
+/// mode: c++ -
+/// c-basic-offset: 2 -
+/// indent-tabs-mode: nil -
+/// End: -
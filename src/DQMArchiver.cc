@@ -4,6 +4,9 @@
 #include "DQMServices/Core/interface/DQMStore.h"
 #include "EventFilter/SMProxyServer/interface/DQMArchiver.h"
 #include "EventFilter/SMProxyServer/interface/Exception.h"
+#include "EventFilter/SMProxyServer/interface/StatisticsReporter.h"
+#include "EventFilter/SMProxyServer/interface/ThreadAffinity.h"
+#include "EventFilter/SMProxyServer/interface/ThreadMonitorCollection.h"
 #include "EventFilter/StorageManager/interface/ConsumerID.h"
 #include "EventFilter/StorageManager/interface/DQMEventMonitorCollection.h"
 #include "EventFilter/StorageManager/interface/QueueID.h"
@@ -43,6 +46,10 @@ namespace smproxy
   {
     try
     {
+      ThreadMonitorCollection::Registration registration(
+        stateMachine_->getStatisticsReporter()->getThreadMonitorCollection(),
+        "DQMArchiver");
+
       doIt();
     }
     catch(xcept::Exception &e)
@@ -66,6 +73,9 @@ namespace smproxy
   
   void DQMArchiver::doIt()
   {
+    ThreadAffinity::pinCurrentThread(
+      stateMachine_->getConfiguration()->getThreadAffinityParams().archiverCPUs_);
+
     stor::RegistrationCollectionPtr registrationCollection =
       stateMachine_->getRegistrationCollection();
     const stor::ConsumerID cid = regPtr_->consumerId();
@@ -76,7 +86,10 @@ namespace smproxy
         dqmEventQueueCollection_->popEvent(cid);
       
       if ( dqmEvent.first.empty() )
+      {
+        ThreadMonitorCollection::WaitTimer waitTimer(ThreadMonitorCollection::QUEUE_WAIT);
         ::sleep(1);
+      }
       else
         handleDQMEvent(dqmEvent.first);
     }
@@ -5,12 +5,20 @@
 #include "EventFilter/SMProxyServer/interface/DQMArchiver.h"
 #include "EventFilter/SMProxyServer/interface/Exception.h"
 #include "EventFilter/SMProxyServer/interface/StateMachine.h"
+#include "EventFilter/SMProxyServer/interface/StatisticsReporter.h"
+#include "EventFilter/SMProxyServer/interface/ThreadMonitorCollection.h"
+#include "EventFilter/SMProxyServer/interface/TriggerMask.h"
 #include "EventFilter/SMProxyServer/src/EventRetriever.icc"
 #include "FWCore/Utilities/interface/UnixSignalHandlers.h"
 
 #include <boost/foreach.hpp>
 #include <boost/pointer_cast.hpp>
 
+#include <algorithm>
+#include <sstream>
+#include <utility>
+#include <vector>
+
 
 namespace smproxy
 {
@@ -19,10 +27,12 @@ namespace smproxy
     StateMachine* stateMachine
   ) :
   stateMachine_(stateMachine),
-  registrationQueue_(stateMachine->getRegistrationQueue())
+  registrationQueue_(stateMachine->getRegistrationQueue()),
+  configuration_(stateMachine->getConfiguration()->getSnapshot()),
+  paused_(false)
   {
     watchDogThread_.reset(
-      new boost::thread( boost::bind( &DataManager::checkForStaleConsumers, this) )
+      new boost::thread( boost::bind( &DataManager::watchDog, this) )
     );
   }
 
@@ -34,14 +44,160 @@ namespace smproxy
   }
   
   
-  void DataManager::start(DataRetrieverParams const& drp)
+  void DataManager::prewarm(ConfigurationSnapshotPtr configuration)
+  {
+    const DataRetrieverParams& drp = configuration->dataRetrieverParams_;
+    {
+      boost::mutex::scoped_lock sl(prewarmMutex_);
+      prewarmedEventServers_.clear();
+      prewarmedInitMsgs_.clear();
+      configuration_ = configuration;
+    }
+
+    // Connect to all SMs in parallel
+    boost::thread_group prewarmThreads;
+    BOOST_FOREACH(const std::string& outputModuleLabel, drp.prewarmOutputModules_)
+    {
+      BOOST_FOREACH(const std::string& sourceURL, drp.smRegistrationList_)
+      {
+        prewarmThreads.create_thread(
+          boost::bind( &DataManager::prewarmConnection, this, outputModuleLabel, sourceURL )
+        );
+      }
+    }
+
+    try
+    {
+      prewarmThreads.join_all();
+    }
+    catch(boost::thread_interrupted)
+    {
+      prewarmThreads.interrupt_all();
+      prewarmThreads.join_all();
+      throw;
+    }
+  }
+  
+  
+  void DataManager::prewarmConnection
+  (
+    const std::string& outputModuleLabel,
+    const std::string& sourceURL
+  )
   {
-    dataRetrieverParams_ = drp;
-    dataEventRetrievers_.clear();
-    dqmEventRetrievers_.clear();
-    edm::shutdown_flag = false;
+    // Register the same way as the EventRetriever does for
+    // a consumer requesting all events from the output module
+    xdaq::ApplicationDescriptor* appDesc = stateMachine_->getApplicationDescriptor();
+    edm::ParameterSet pset;
+    pset.addUntrackedParameter<std::string>("consumerName",
+      appDesc->getContextDescriptor()->getURL()+"/"+appDesc->getURN());
+    pset.addUntrackedParameter<std::string>("SelectHLTOutput", outputModuleLabel);
+    pset.addUntrackedParameter<std::string>("TriggerSelector", "");
+    pset.addParameter<TriggerMask::Strings>("TrackedEventSelection", TriggerMask::Strings());
+    if ( dataRetrieverParams().allowMissingSM_ )
+    {
+      pset.addUntrackedParameter<int>("maxConnectTries", 0);
+    }
+    else
+    {
+      pset.addUntrackedParameter<int>("maxConnectTries", dataRetrieverParams().maxConnectionRetries_);
+      pset.addUntrackedParameter<int>("connectTrySleepTime", dataRetrieverParams().connectTrySleepTime_);
+    }
+    pset.addUntrackedParameter<int>("headerRetryInterval", dataRetrieverParams().headerRetryInterval_);
+    pset.addUntrackedParameter<int>("prescale", 1);
+    pset.addUntrackedParameter<int>("retryInterval", dataRetrieverParams().retryInterval_);
+
+    stor::EventConsRegPtr regPtr( new stor::EventConsumerRegistrationInfo(pset,
+        stateMachine_->getConfiguration()->getEventServingParams()) );
+    regPtr->setSourceURL(sourceURL);
+
+    try
+    {
+      DataEventRetriever::EventServerPtr eventServer(
+        new DataEventRetriever::EventServer(regPtr->getPSet())
+      );
+      stor::CurlInterface::Content data;
+      eventServer->getInitMsg(data);
+      InitMsgView initMsgView(&data[0]);
+      stateMachine_->getInitMsgCollection()->addIfUnique(initMsgView);
+
+      boost::mutex::scoped_lock sl(prewarmMutex_);
+      prewarmedEventServers_[outputModuleLabel][sourceURL] = eventServer;
+      prewarmedInitMsgs_.push_back(data);
+    }
+    catch (cms::Exception& e)
+    {
+      // The EventRetriever will try again when the first consumer registers
+    }
+  }
+  
+  
+  void DataManager::takePrewarmedEventServers
+  (
+    stor::EventConsRegPtr eventConsumer,
+    DataEventRetriever::EventServersByURL& eventServers
+  )
+  {
+    boost::mutex::scoped_lock sl(prewarmMutex_);
+
+    PrewarmedEventServers::iterator pos =
+      prewarmedEventServers_.find(eventConsumer->outputModuleLabel());
+    if ( pos == prewarmedEventServers_.end() ) return;
+
+    // The prewarmed connections request all events from the output module
+    const bool requestsAllEvents =
+      ( eventConsumer->triggerSelection().empty() && eventConsumer->eventSelection().empty() ) ||
+      ( dataRetrieverParams().routeByTriggerBits_ &&
+        TriggerMask::isSimple(eventConsumer->triggerSelection(), eventConsumer->eventSelection()) );
+    if ( ! requestsAllEvents ) return;
+
+    eventServers.swap(pos->second);
+    prewarmedEventServers_.erase(pos);
+  }
+  
+  
+  void DataManager::start(ConfigurationSnapshotPtr configuration)
+  {
+    if ( paused_ )
+    {
+      // Warm restart: the retrievers kept from the last run
+      // fetch the INIT messages for the new run themselves
+      BOOST_FOREACH(
+        const DataEventRetrieverMap::value_type& pair,
+        dataEventRetrievers_
+      ) pair.second->resume();
+
+      BOOST_FOREACH(
+        const DQMEventRetrieverMap::value_type& pair,
+        dqmEventRetrievers_
+      ) pair.second->resume();
+
+      paused_ = false;
+    }
+    else
+    {
+      {
+        boost::mutex::scoped_lock sl(retrieversMutex_);
+        configuration_ = configuration;
+        dataEventRetrievers_.clear();
+        dqmEventRetrievers_.clear();
+      }
+
+      {
+        // The INIT messages retrieved while configuring are cleared
+        // when starting. Add them back for the first run only.
+        boost::mutex::scoped_lock sl(prewarmMutex_);
+        BOOST_FOREACH(stor::CurlInterface::Content& initMsg, prewarmedInitMsgs_)
+        {
+          InitMsgView initMsgView(&initMsg[0]);
+          stateMachine_->getInitMsgCollection()->addIfUnique(initMsgView);
+        }
+        prewarmedInitMsgs_.clear();
+      }
+      edm::shutdown_flag = false;
+    }
     thread_.reset(
-      new boost::thread( boost::bind( &DataManager::doIt, this) )
+      new boost::thread( boost::bind( &DataManager::activity, this) )
     );
   }
   
@@ -54,15 +210,90 @@ namespace smproxy
 
     edm::shutdown_flag = true;
 
+    // Stop all retrievers at once. Each stopping thread holds on to
+    // its retriever. Thus, a retriever still blocked in a transfer
+    // when the deadline has passed is left to finish on its own.
+    typedef boost::shared_ptr<boost::thread> ThreadPtr;
+    typedef std::vector< std::pair<std::string, ThreadPtr> > StoppingThreads;
+    StoppingThreads stoppingThreads;
+
     BOOST_FOREACH(
       const DataEventRetrieverMap::value_type& pair,
       dataEventRetrievers_
-    ) pair.second->stop();
+    )
+    {
+      stoppingThreads.push_back(std::make_pair(
+          pair.first.substr(0, pair.first.find(';')),
+          ThreadPtr(new boost::thread(boost::bind(&DataEventRetriever::stop, pair.second)))
+        ));
+    }
 
     BOOST_FOREACH(
       const DQMEventRetrieverMap::value_type& pair,
       dqmEventRetrievers_
-    ) pair.second->stop();
+    )
+    {
+      stoppingThreads.push_back(std::make_pair(
+          pair.first->topLevelFolderName(),
+          ThreadPtr(new boost::thread(boost::bind(&DQMEventRetriever::stop, pair.second)))
+        ));
+    }
+
+    const stor::utils::TimePoint_t deadline =
+      stor::utils::getCurrentTime() + dataRetrieverParams().stopTimeout_;
+    std::vector<std::string> stragglers;
+
+    BOOST_FOREACH(const StoppingThreads::value_type& stoppingThread, stoppingThreads)
+    {
+      const stor::utils::TimePoint_t now = stor::utils::getCurrentTime();
+      const stor::utils::Duration_t timeLeft = deadline > now ?
+        deadline - now : boost::posix_time::seconds(0);
+      if ( ! stoppingThread.second->timed_join(timeLeft) )
+        stragglers.push_back(stoppingThread.first);
+    }
+
+    if ( ! stragglers.empty() )
+    {
+      std::ostringstream msg;
+      msg << stragglers.size() << " of " << stoppingThreads.size()
+        << " event retrievers are still stopping after "
+        << dataRetrieverParams().stopTimeout_.total_seconds()
+        << " s. They exit on their own once their pending SM requests return:";
+      BOOST_FOREACH(const std::string& straggler, stragglers)
+        msg << " " << straggler;
+      XCEPT_DECLARE(exception::DataRetrieval, ex, msg.str());
+      stateMachine_->getStatisticsReporter()->alarmHandler()->
+        notifySentinel(stor::AlarmHandler::WARNING, ex);
+    }
+
+    {
+      // The connections opened while configuring are only valid for the
+      // first run. The SMs might have been restarted by the next one.
+      boost::mutex::scoped_lock sl(prewarmMutex_);
+      prewarmedEventServers_.clear();
+    }
+
+    paused_ = false;
+  }
+  
+  
+  void DataManager::pause()
+  {
+    // enqueue a dummy RegistrationInfoBase to tell the thread to stop
+    registrationQueue_->enqWait( stor::RegPtr() );
+    thread_->join();
+
+    BOOST_FOREACH(
+      const DataEventRetrieverMap::value_type& pair,
+      dataEventRetrievers_
+    ) pair.second->pause();
+
+    BOOST_FOREACH(
+      const DQMEventRetrieverMap::value_type& pair,
+      dqmEventRetrievers_
+    ) pair.second->pause();
+
+    paused_ = true;
   }
   
   
@@ -74,11 +305,16 @@ namespace smproxy
   {
     if ( ! eventConsumer ) return false;
     
-    DataEventRetrieverMap::const_iterator pos =
-      dataEventRetrievers_.find(eventConsumer);
-    if ( pos == dataEventRetrievers_.end() ) return false;
+    DataEventRetrieverPtr dataEventRetriever;
+    {
+      boost::mutex::scoped_lock sl(retrieversMutex_);
+      const std::string key = selectionKey(eventConsumer, dataRetrieverParams());
+      DataEventRetrieverMap::const_iterator pos = dataEventRetrievers_.find(key);
+      if ( pos == dataEventRetrievers_.end() ) return false;
+      dataEventRetriever = pos->second;
+    }
     
-    queueIDs = pos->second->getQueueIDs();
+    queueIDs = dataEventRetriever->getQueueIDs();
     return true;
   }
   
@@ -91,11 +327,16 @@ namespace smproxy
   {
     if ( ! dqmEventConsumer ) return false;
     
-    DQMEventRetrieverMap::const_iterator pos =
-      dqmEventRetrievers_.find(dqmEventConsumer);
-    if ( pos == dqmEventRetrievers_.end() ) return false;
+    DQMEventRetrieverPtr dqmEventRetriever;
+    {
+      boost::mutex::scoped_lock sl(retrieversMutex_);
+      DQMEventRetrieverMap::const_iterator pos =
+        dqmEventRetrievers_.find(dqmEventConsumer);
+      if ( pos == dqmEventRetrievers_.end() ) return false;
+      dqmEventRetriever = pos->second;
+    }
     
-    queueIDs = pos->second->getQueueIDs();
+    queueIDs = dqmEventRetriever->getQueueIDs();
     return true;
   }
   
@@ -104,6 +345,10 @@ namespace smproxy
   {
     try
     {
+      ThreadMonitorCollection::Registration registration(
+        stateMachine_->getStatisticsReporter()->getThreadMonitorCollection(),
+        "DataManager");
+
       doIt();
     }
     catch(xcept::Exception &e)
@@ -118,7 +363,7 @@ namespace smproxy
     }
     catch(...)
     {
-      std::string errorMsg = "Unknown exception in watch dog";
+      std::string errorMsg = "Unknown exception in registration thread";
       XCEPT_DECLARE(exception::Exception,
         sentinelException, errorMsg);
       stateMachine_->moveToFailedState(sentinelException);
@@ -128,25 +373,98 @@ namespace smproxy
   
   void DataManager::doIt()
   {
+    typedef std::vector< std::pair<int,stor::RegPtr> > Registrations;
+    Registrations registrations;
     stor::RegPtr regPtr;
     bool process(true);
 
+    const ConfigurationSnapshotPtr configuration =
+      stateMachine_->getConfiguration()->getSnapshot();
+    const QueueConfigurationParams& queueParams = configuration->queueConfigParams_;
+
+    ThreadAffinity::pinCurrentThread(configuration->threadAffinityParams_.dataManagerCPUs_);
+
     DQMArchiver dqmArchiver(stateMachine_);
     addDQMEventConsumer(dqmArchiver.getRegPtr());
 
     do
     {
-      registrationQueue_->deqWait(regPtr);
+      // Take all registrations queued since the last batch at once
+      // to free the queue for the consumers registering meanwhile
+      {
+        ThreadMonitorCollection::WaitTimer waitTimer(ThreadMonitorCollection::QUEUE_WAIT);
+        registrationQueue_->deqWait(regPtr);
+      }
+      registrations.push_back(std::make_pair(registrationRank(regPtr), regPtr));
+      while ( registrationQueue_->deqNowait(regPtr) )
+        registrations.push_back(std::make_pair(registrationRank(regPtr), regPtr));
+
+      adjustRegistrationQueueCapacity(registrations.size(), queueParams);
 
-      if ( ! (addEventConsumer(regPtr) || addDQMEventConsumer(regPtr)) )
+      // Serve the high priority consumers of the batch first
+      std::stable_sort(registrations.begin(), registrations.end(), rankComp);
+
+      for ( Registrations::const_iterator it = registrations.begin(),
+              itEnd = registrations.end(); process && it != itEnd; ++it )
       {
-        // base type received, signalling the end of the run
-        process = false;
+        if ( ! (addEventConsumer(it->second) || addDQMEventConsumer(it->second)) )
+        {
+          // base type received, signalling the end of the run
+          process = false;
+        }
       }
+      registrations.clear();
     } while (process);
   }
   
   
+  int DataManager::registrationRank(const stor::RegPtr regPtr) const
+  {
+    // The base type signalling the end of the run goes last
+    if ( ! boost::dynamic_pointer_cast<stor::EventConsumerRegistrationInfo>(regPtr) &&
+      ! boost::dynamic_pointer_cast<stor::DQMEventConsumerRegistrationInfo>(regPtr) )
+      return PRIORITY_CLASSES;
+
+    return getConsumerPriority(regPtr, dataRetrieverParams());
+  }
+  
+  
+  bool DataManager::rankComp
+  (
+    const std::pair<int,stor::RegPtr>& a,
+    const std::pair<int,stor::RegPtr>& b
+  )
+  {
+    return ( a.first < b.first );
+  }
+  
+  
+  void DataManager::adjustRegistrationQueueCapacity
+  (
+    const size_t backlog,
+    QueueConfigurationParams const& queueParams
+  )
+  {
+    // Double the capacity while the registrations pile up and
+    // halve it again down to the configured size once the burst
+    // is over. The capacity can only be changed while the queue
+    // is empty. Otherwise, it is tried again with the next batch.
+    const size_t minCapacity = queueParams.registrationQueueSize_;
+    const size_t maxCapacity =
+      std::max(queueParams.registrationQueueMaxSize_, queueParams.registrationQueueSize_);
+    const size_t capacity = registrationQueue_->capacity();
+
+    size_t newCapacity = capacity;
+    if ( backlog * 2 > capacity )
+      newCapacity = std::min(capacity * 2, maxCapacity);
+    else if ( backlog * 8 < capacity )
+      newCapacity = std::max(capacity / 2, minCapacity);
+
+    if ( newCapacity != capacity )
+      registrationQueue_->setCapacity(newCapacity);
+  }
+  
+  
   bool DataManager::addEventConsumer(stor::RegPtr regPtr)
   {
     stor::EventConsRegPtr eventConsumer =
@@ -154,18 +472,19 @@ namespace smproxy
     
     if ( ! eventConsumer ) return false;
 
-    DataEventRetrieverMap::iterator pos = dataEventRetrievers_.lower_bound(eventConsumer);
-    if (
-      pos == dataEventRetrievers_.end() ||
-      (dataEventRetrievers_.key_comp()(eventConsumer, pos->first))
-    )
+    const std::string key = selectionKey(eventConsumer, dataRetrieverParams());
+    DataEventRetrieverMap::iterator pos = dataEventRetrievers_.find(key);
+    if ( pos == dataEventRetrievers_.end() )
     {
       // no retriever found for this event requests
+      DataEventRetriever::EventServersByURL prewarmedEventServers;
+      takePrewarmedEventServers(eventConsumer, prewarmedEventServers);
       DataEventRetrieverPtr dataEventRetriever(
-        new DataEventRetriever(stateMachine_, eventConsumer)
+        new DataEventRetriever(stateMachine_, eventConsumer, prewarmedEventServers)
       );
-      dataEventRetrievers_.insert(pos,
-        DataEventRetrieverMap::value_type(eventConsumer, dataEventRetriever));
+      boost::mutex::scoped_lock sl(retrieversMutex_);
+      dataEventRetrievers_.insert(
+        DataEventRetrieverMap::value_type(key, dataEventRetriever));
     }
     else
     {
@@ -176,6 +495,37 @@ namespace smproxy
   }
   
   
+  std::string DataManager::selectionKey
+  (
+    const stor::EventConsRegPtr eventConsumer,
+    DataRetrieverParams const& dataRetrieverParams
+  )
+  {
+    std::ostringstream key;
+    key << eventConsumer->outputModuleLabel() << ";";
+
+    if ( dataRetrieverParams.routeByTriggerBits_ &&
+      TriggerMask::isSimple(eventConsumer->triggerSelection(), eventConsumer->eventSelection()) )
+    {
+      key << "routed;";
+    }
+    else
+    {
+      key << eventConsumer->triggerSelection() << ";";
+      BOOST_FOREACH(const std::string& selection, eventConsumer->eventSelection())
+        key << selection << ",";
+      key << ";";
+    }
+
+    key << eventConsumer->queueSize() << ";"
+      << eventConsumer->queuePolicy() << ";"
+      << eventConsumer->secondsToStale().total_microseconds() << ";"
+      << getConsumerPriority(eventConsumer, dataRetrieverParams);
+
+    return key.str();
+  }
+  
+  
   bool DataManager::addDQMEventConsumer(stor::RegPtr regPtr)
   {
     stor::DQMEventConsRegPtr dqmEventConsumer =
@@ -193,6 +543,7 @@ namespace smproxy
       DQMEventRetrieverPtr dqmEventRetriever(
         new DQMEventRetriever(stateMachine_, dqmEventConsumer)
       );
+      boost::mutex::scoped_lock sl(retrieversMutex_);
       dqmEventRetrievers_.insert(pos,
         DQMEventRetrieverMap::value_type(dqmEventConsumer, dqmEventRetriever));
     }
@@ -209,6 +560,10 @@ namespace smproxy
   {
     try
     {
+      ThreadMonitorCollection::Registration registration(
+        stateMachine_->getStatisticsReporter()->getThreadMonitorCollection(),
+        "DataManager watchdog");
+
       checkForStaleConsumers();
     }
     catch(boost::thread_interrupted)
@@ -242,12 +597,23 @@ namespace smproxy
     stor::DQMEventQueueCollectionPtr dqmEventQueueCollection =
       stateMachine_->getDQMEventQueueCollection();
     
+    // Expiring the event consumer queues only touches the expired
+    // ones. Thus, it is done at the resolution of the expiry deadlines.
+    // The DQM consumer queues are still scanned once per second.
+    const stor::utils::Duration_t dqmCheckInterval = boost::posix_time::seconds(1);
+    stor::utils::TimePoint_t nextDQMCheck = stor::utils::getCurrentTime();
+
     while (true)
     {
-      boost::this_thread::sleep(boost::posix_time::seconds(1));
+      boost::this_thread::sleep(eventQueueCollection->expiryResolution());
+      watchDogAffinity_.apply();
       stor::utils::TimePoint_t now = stor::utils::getCurrentTime();
       eventQueueCollection->clearStaleQueues(now);
-      dqmEventQueueCollection->clearStaleQueues(now);
+      if ( now >= nextDQMCheck )
+      {
+        dqmEventQueueCollection->clearStaleQueues(now);
+        nextDQMCheck = now + dqmCheckInterval;
+      }
     }
   }
 
@@ -1,6 +1,7 @@
 // $Id: DataRetrieverMonitorCollection.cc,v 1.2 2011/03/07 15:41:55 mommsen Exp $
 /// @file: DataRetrieverMonitorCollection.cc
 
+#include <algorithm>
 #include <string>
 #include <sstream>
 #include <iomanip>
@@ -9,6 +10,7 @@
 
 #include "EventFilter/SMProxyServer/interface/Exception.h"
 #include "EventFilter/SMProxyServer/interface/DataRetrieverMonitorCollection.h"
+#include "EventFilter/SMProxyServer/interface/ThreadMonitorCollection.h"
 
 
 namespace smproxy {
@@ -22,8 +24,25 @@ namespace smproxy {
   updateInterval_(updateInterval),
   alarmHandler_(alarmHandler),
   totals_(updateInterval),
+  eventMQs_(new EventMQs()),
+  keepConnectionsOnReset_(false),
+  removedConnectionLifetime_(boost::posix_time::seconds(60)),
+  nextRemovalTime_(boost::posix_time::pos_infin),
   eventTypeMqMap_(updateInterval)
-  {}
+  {
+    for (int stage = FETCH_STAGE; stage < PIPELINE_STAGES; ++stage)
+    {
+      pipelineMQs_.push_back(
+        PipelineStageMQPtr(new PipelineStageMQ(updateInterval))
+      );
+    }
+    for (int priority = HIGH_PRIORITY; priority < PRIORITY_CLASSES; ++priority)
+    {
+      priorityMQs_.push_back(
+        PriorityClassMQPtr(new PriorityClassMQ(updateInterval))
+      );
+    }
+  }
   
   
   ConnectionID DataRetrieverMonitorCollection::addNewConnection
@@ -35,16 +54,19 @@ namespace smproxy {
     ++nextConnectionId_;
     
     DataRetrieverMQPtr dataRetrieverMQ( new DataRetrieverMQ(regPtr, updateInterval_) );
-    retrieverMqMap_.insert(
-      RetrieverMqMap::value_type(nextConnectionId_, dataRetrieverMQ)
-    );
     
-    eventTypeMqMap_.insert(regPtr);
+    dataRetrieverMQ->eventTypeMQ_ = eventTypeMqMap_.insert(regPtr);
     
-    connectionMqMap_.insert(ConnectionMqMap::value_type(
+    dataRetrieverMQ->connectionMQ_ = connectionMqMap_.insert(ConnectionMqMap::value_type(
         regPtr->sourceURL(),
         EventMQPtr(new EventMQ(updateInterval_))
-      ));
+      )).first->second;
+    
+    retrieverMqMap_.insert(
+      RetrieverMqMap::value_type(nextConnectionId_, dataRetrieverMQ)
+    );
+    
+    updateEventMQs();
     
     return nextConnectionId_;
   }
@@ -56,14 +78,37 @@ namespace smproxy {
     const ConnectionStatus& status
   )
   {
-    boost::mutex::scoped_lock sl(statsMutex_);
+    boost::mutex::scoped_lock sl(statsMutex_, boost::defer_lock);
+    ThreadMonitorCollection::lock(sl, ThreadMonitorCollection::STATS_LOCK_WAIT);
     RetrieverMqMap::const_iterator pos = retrieverMqMap_.find(connectionId);
     if ( pos == retrieverMqMap_.end() ) return false;
+    // A closed connection is not re-opened
+    if ( pos->second->connectionStatus_ == CLOSED ) return true;
     pos->second->connectionStatus_ = status;
     return true;
   }
   
   
+  bool DataRetrieverMonitorCollection::removeConnection
+  (
+    const ConnectionID& connectionId
+  )
+  {
+    boost::mutex::scoped_lock sl(statsMutex_);
+    RetrieverMqMap::const_iterator pos = retrieverMqMap_.find(connectionId);
+    if ( pos == retrieverMqMap_.end() ) return false;
+    
+    pos->second->connectionStatus_ = CLOSED;
+    if ( pos->second->removalTime_ == boost::posix_time::pos_infin )
+    {
+      pos->second->removalTime_ =
+        stor::utils::getCurrentTime() + removedConnectionLifetime_;
+      nextRemovalTime_ = std::min(nextRemovalTime_, pos->second->removalTime_);
+    }
+    return true;
+  }
+  
+  
   bool DataRetrieverMonitorCollection::getEventTypeStatsForConnection
   (
     const ConnectionID& connectionId,
@@ -89,21 +134,16 @@ namespace smproxy {
     const unsigned int& size
   )
   {
-    boost::mutex::scoped_lock sl(statsMutex_);
+    boost::mutex::scoped_lock sl(statsMutex_, boost::defer_lock);
+    ThreadMonitorCollection::lock(sl, ThreadMonitorCollection::STATS_LOCK_WAIT);
     
     RetrieverMqMap::const_iterator retrieverPos = retrieverMqMap_.find(connectionId);
     if ( retrieverPos == retrieverMqMap_.end() ) return false;
     
     const double sizeKB = static_cast<double>(size) / 1024;
     retrieverPos->second->eventMQ_->size_.addSample(sizeKB);
-    
-    const stor::RegPtr regPtr = retrieverPos->second->regPtr_;
-    
-    eventTypeMqMap_.addSample(regPtr, sizeKB);
-    
-    const std::string sourceURL = regPtr->sourceURL();
-    ConnectionMqMap::const_iterator connectionPos = connectionMqMap_.find(sourceURL);
-    connectionPos->second->size_.addSample(sizeKB);
+    retrieverPos->second->eventTypeMQ_->size_.addSample(sizeKB);
+    retrieverPos->second->connectionMQ_->size_.addSample(sizeKB);
     
     totals_.size_.addSample(sizeKB);
     
@@ -116,27 +156,105 @@ namespace smproxy {
     const ConnectionID& connectionId
   )
   {
-    boost::mutex::scoped_lock sl(statsMutex_);
+    boost::mutex::scoped_lock sl(statsMutex_, boost::defer_lock);
+    ThreadMonitorCollection::lock(sl, ThreadMonitorCollection::STATS_LOCK_WAIT);
     
     RetrieverMqMap::const_iterator retrieverPos = retrieverMqMap_.find(connectionId);
     if ( retrieverPos == retrieverMqMap_.end() ) return false;
     
     retrieverPos->second->eventMQ_->corruptedEvents_.addSample(1);
+    retrieverPos->second->eventTypeMQ_->corruptedEvents_.addSample(1);
+    retrieverPos->second->connectionMQ_->corruptedEvents_.addSample(1);
     
-    const stor::RegPtr regPtr = retrieverPos->second->regPtr_;
+    totals_.corruptedEvents_.addSample(1);
+
+    return true;
+  }
+  
+  
+  void DataRetrieverMonitorCollection::receivedCorruptedSpooledEvent()
+  {
+    boost::mutex::scoped_lock sl(statsMutex_, boost::defer_lock);
+    ThreadMonitorCollection::lock(sl, ThreadMonitorCollection::STATS_LOCK_WAIT);
+
+    totals_.corruptedEvents_.addSample(1);
+  }
+  
+  
+  bool DataRetrieverMonitorCollection::addDiscardedSample
+  (
+    const ConnectionID& connectionId,
+    const unsigned int& size
+  )
+  {
+    boost::mutex::scoped_lock sl(statsMutex_, boost::defer_lock);
+    ThreadMonitorCollection::lock(sl, ThreadMonitorCollection::STATS_LOCK_WAIT);
     
-    eventTypeMqMap_.receivedCorruptedEvent(regPtr);
+    RetrieverMqMap::const_iterator retrieverPos = retrieverMqMap_.find(connectionId);
+    if ( retrieverPos == retrieverMqMap_.end() ) return false;
     
-    const std::string sourceURL = regPtr->sourceURL();
-    ConnectionMqMap::const_iterator connectionPos = connectionMqMap_.find(sourceURL);
-    connectionPos->second->corruptedEvents_.addSample(1);
+    const double sizeKB = static_cast<double>(size) / 1024;
+    retrieverPos->second->eventMQ_->discardedEvents_.addSample(sizeKB);
+    retrieverPos->second->eventTypeMQ_->discardedEvents_.addSample(sizeKB);
+    retrieverPos->second->connectionMQ_->discardedEvents_.addSample(sizeKB);
     
-    totals_.corruptedEvents_.addSample(1);
+    totals_.discardedEvents_.addSample(sizeKB);
 
     return true;
   }
   
   
+  void DataRetrieverMonitorCollection::addPipelineStageSample
+  (
+    const PipelineStage& stage,
+    const size_t& occupancy,
+    const double& stallTime
+  )
+  {
+    // The MonitoredQuantities are thread-safe and the vector is
+    // never changed after construction. Thus, no lock is needed.
+    pipelineMQs_[stage]->occupancy_.addSample(occupancy);
+    pipelineMQs_[stage]->stallTime_.addSample(stallTime);
+  }
+  
+  
+  void DataRetrieverMonitorCollection::getPipelineStats(PipelineStats& stats) const
+  {
+    stats.resize(PIPELINE_STAGES);
+    for (int stage = FETCH_STAGE; stage < PIPELINE_STAGES; ++stage)
+    {
+      pipelineMQs_[stage]->getStats(stats[stage]);
+    }
+  }
+  
+  
+  void DataRetrieverMonitorCollection::addServedEvents
+  (
+    const ConsumerPriority& priority,
+    const size_t& consumerCount
+  )
+  {
+    // The vector is never changed after construction. Thus, no lock is needed.
+    priorityMQs_[priority]->servedEvents_.addSample(consumerCount);
+  }
+  
+  
+  void DataRetrieverMonitorCollection::addShedEvent(const ConsumerPriority& priority)
+  {
+    priorityMQs_[priority]->shedEvents_.addSample(1);
+  }
+  
+  
+  void DataRetrieverMonitorCollection::getPriorityStats(PriorityStats& stats) const
+  {
+    stats.resize(PRIORITY_CLASSES);
+    for (int priority = HIGH_PRIORITY; priority < PRIORITY_CLASSES; ++priority)
+    {
+      priorityMQs_[priority]->getStats(stats[priority]);
+    }
+  }
+  
+  
   void DataRetrieverMonitorCollection::getSummaryStats(SummaryStats& stats) const
   {
     boost::mutex::scoped_lock sl(statsMutex_);
@@ -147,6 +265,7 @@ namespace smproxy {
     for (RetrieverMqMap::const_iterator it = retrieverMqMap_.begin(),
            itEnd = retrieverMqMap_.end(); it != itEnd; ++it)
     {
+      if ( it->second->connectionStatus_ == CLOSED ) continue;
       ++stats.registeredSMs;
       if ( it->second->connectionStatus_ == CONNECTED )
         ++stats.activeSMs;
@@ -232,67 +351,164 @@ namespace smproxy {
   }
   
   
-  void DataRetrieverMonitorCollection::do_calculateStatistics()
+  void DataRetrieverMonitorCollection::updateEventMQs()
   {
-    boost::mutex::scoped_lock sl(statsMutex_);
-    
-    totals_.calculateStatistics();
+    boost::shared_ptr<EventMQs> eventMQs( new EventMQs() );
+    eventMQs->reserve(2 * retrieverMqMap_.size() + connectionMqMap_.size());
     
     for (RetrieverMqMap::const_iterator it = retrieverMqMap_.begin(),
            itEnd = retrieverMqMap_.end(); it != itEnd; ++it)
     {
-      it->second->eventMQ_->calculateStatistics();
+      eventMQs->push_back(it->second->eventMQ_);
     }
     
     for (ConnectionMqMap::const_iterator it = connectionMqMap_.begin(),
            itEnd = connectionMqMap_.end(); it != itEnd; ++it)
     {
-      it->second->calculateStatistics();
+      eventMQs->push_back(it->second);
     }
     
-    eventTypeMqMap_.calculateStatistics();
-
-    sendAlarms();
+    eventTypeMqMap_.appendEventMQs(*eventMQs);
+    
+    eventMQs_ = eventMQs;
   }
   
   
-  void DataRetrieverMonitorCollection::do_reset()
+  void DataRetrieverMonitorCollection::removeExpiredConnections
+  (
+    const stor::utils::TimePoint_t& now
+  )
   {
-    boost::mutex::scoped_lock sl(statsMutex_);
-    totals_.reset();
-    retrieverMqMap_.clear();
-    connectionMqMap_.clear();
-    eventTypeMqMap_.clear();
+    nextRemovalTime_ = boost::posix_time::pos_infin;
+    
+    RetrieverMqMap::iterator it = retrieverMqMap_.begin();
+    while ( it != retrieverMqMap_.end() )
+    {
+      if ( it->second->removalTime_ <= now )
+      {
+        retrieverMqMap_.erase(it++);
+      }
+      else
+      {
+        nextRemovalTime_ = std::min(nextRemovalTime_, it->second->removalTime_);
+        ++it;
+      }
+    }
+    
+    // Drop the SM and event type entries no remaining connection refers to
+    EventMQs inUse;
+    inUse.reserve(2 * retrieverMqMap_.size());
+    for (RetrieverMqMap::const_iterator it = retrieverMqMap_.begin(),
+           itEnd = retrieverMqMap_.end(); it != itEnd; ++it)
+    {
+      inUse.push_back(it->second->connectionMQ_);
+      inUse.push_back(it->second->eventTypeMQ_);
+    }
+    std::sort(inUse.begin(), inUse.end());
+    
+    ConnectionMqMap::iterator connectionPos = connectionMqMap_.begin();
+    while ( connectionPos != connectionMqMap_.end() )
+    {
+      if ( std::binary_search(inUse.begin(), inUse.end(), connectionPos->second) )
+        ++connectionPos;
+      else
+        connectionMqMap_.erase(connectionPos++);
+    }
+    
+    eventTypeMqMap_.eraseUnused(inUse);
+    
+    updateEventMQs();
   }
   
   
-  bool DataRetrieverMonitorCollection::EventTypeMqMap::
-  insert(const stor::RegPtr consumer)
+  void DataRetrieverMonitorCollection::do_calculateStatistics()
   {
-    return (
-      insert(boost::dynamic_pointer_cast<stor::EventConsumerRegistrationInfo>(consumer)) ||
-      insert(boost::dynamic_pointer_cast<stor::DQMEventConsumerRegistrationInfo>(consumer))
-    );
+    EventMQsPtr eventMQs;
+    {
+      boost::mutex::scoped_lock sl(statsMutex_);
+      
+      const stor::utils::TimePoint_t now = stor::utils::getCurrentTime();
+      if ( now >= nextRemovalTime_ )
+        removeExpiredConnections(now);
+      
+      eventMQs = eventMQs_;
+    }
+    
+    // The MonitoredQuantities are thread-safe. Thus, the
+    // data path is not blocked while calculating them.
+    totals_.calculateStatistics();
+    
+    for (EventMQs::const_iterator it = eventMQs->begin(),
+           itEnd = eventMQs->end(); it != itEnd; ++it)
+    {
+      (*it)->calculateStatistics();
+    }
+
+    for (PipelineMQs::const_iterator it = pipelineMQs_.begin(),
+           itEnd = pipelineMQs_.end(); it != itEnd; ++it)
+    {
+      (*it)->calculateStatistics();
+    }
+
+    for (PriorityMQs::const_iterator it = priorityMQs_.begin(),
+           itEnd = priorityMQs_.end(); it != itEnd; ++it)
+    {
+      (*it)->calculateStatistics();
+    }
+
+    sendAlarms();
   }
   
   
-  bool DataRetrieverMonitorCollection::EventTypeMqMap::
-  addSample(const stor::RegPtr consumer, const double& sizeKB)
+  void DataRetrieverMonitorCollection::do_reset()
   {
-    return (
-      addSample(boost::dynamic_pointer_cast<stor::EventConsumerRegistrationInfo>(consumer), sizeKB) ||
-      addSample(boost::dynamic_pointer_cast<stor::DQMEventConsumerRegistrationInfo>(consumer), sizeKB)
-    );
+    boost::mutex::scoped_lock sl(statsMutex_);
+    totals_.reset();
+    for (PipelineMQs::const_iterator it = pipelineMQs_.begin(),
+           itEnd = pipelineMQs_.end(); it != itEnd; ++it)
+    {
+      (*it)->reset();
+    }
+    for (PriorityMQs::const_iterator it = priorityMQs_.begin(),
+           itEnd = priorityMQs_.end(); it != itEnd; ++it)
+    {
+      (*it)->reset();
+    }
+
+    if ( keepConnectionsOnReset_ )
+    {
+      for (RetrieverMqMap::const_iterator it = retrieverMqMap_.begin(),
+             itEnd = retrieverMqMap_.end(); it != itEnd; ++it)
+      {
+        it->second->eventMQ_->reset();
+      }
+      for (ConnectionMqMap::const_iterator it = connectionMqMap_.begin(),
+             itEnd = connectionMqMap_.end(); it != itEnd; ++it)
+      {
+        it->second->reset();
+      }
+      eventTypeMqMap_.reset();
+    }
+    else
+    {
+      retrieverMqMap_.clear();
+      connectionMqMap_.clear();
+      eventTypeMqMap_.clear();
+      nextRemovalTime_ = boost::posix_time::pos_infin;
+      updateEventMQs();
+    }
   }
   
   
-  bool DataRetrieverMonitorCollection::EventTypeMqMap::
-  receivedCorruptedEvent(const stor::RegPtr consumer)
+  DataRetrieverMonitorCollection::EventMQPtr
+  DataRetrieverMonitorCollection::EventTypeMqMap::
+  insert(const stor::RegPtr consumer)
   {
-    return (
-      receivedCorruptedEvent(boost::dynamic_pointer_cast<stor::EventConsumerRegistrationInfo>(consumer)) ||
-      receivedCorruptedEvent(boost::dynamic_pointer_cast<stor::DQMEventConsumerRegistrationInfo>(consumer))
-    );
+    EventMQPtr eventMQ =
+      insert(boost::dynamic_pointer_cast<stor::EventConsumerRegistrationInfo>(consumer));
+    if ( ! eventMQ )
+      eventMQ = insert(boost::dynamic_pointer_cast<stor::DQMEventConsumerRegistrationInfo>(consumer));
+    return eventMQ;
   }
   
   
@@ -308,6 +524,7 @@ namespace smproxy {
       EventStats eventStats;
       it->second->size_.getStats(eventStats.sizeStats);
       it->second->corruptedEvents_.getStats(eventStats.corruptedEventsStats);
+      it->second->discardedEvents_.getStats(eventStats.discardedEventsStats);
       eventTypeStats.push_back(
         std::make_pair(it->first, eventStats));
     }
@@ -318,6 +535,7 @@ namespace smproxy {
       EventStats eventStats;
       it->second->size_.getStats(eventStats.sizeStats);
       it->second->corruptedEvents_.getStats(eventStats.corruptedEventsStats);
+      it->second->discardedEvents_.getStats(eventStats.discardedEventsStats);
       eventTypeStats.push_back(
         std::make_pair(it->first, eventStats));
     }
@@ -325,19 +543,56 @@ namespace smproxy {
   
   
   void DataRetrieverMonitorCollection::EventTypeMqMap::
-  calculateStatistics()
+  appendEventMQs(EventMQs& eventMQs) const
+  {
+    for (EventMap::const_iterator it = eventMap_.begin(),
+           itEnd = eventMap_.end(); it != itEnd; ++it)
+    {
+      eventMQs.push_back(it->second);
+    }
+    for (DQMEventMap::const_iterator it = dqmEventMap_.begin(),
+           itEnd = dqmEventMap_.end(); it != itEnd; ++it)
+    {
+      eventMQs.push_back(it->second);
+    }
+  }
+  
+  
+  void DataRetrieverMonitorCollection::EventTypeMqMap::
+  eraseUnused(const EventMQs& inUse)
+  {
+    // inUse must be sorted
+    EventMap::iterator it = eventMap_.begin();
+    while ( it != eventMap_.end() )
+    {
+      if ( std::binary_search(inUse.begin(), inUse.end(), it->second) )
+        ++it;
+      else
+        eventMap_.erase(it++);
+    }
+    DQMEventMap::iterator dqmIt = dqmEventMap_.begin();
+    while ( dqmIt != dqmEventMap_.end() )
+    {
+      if ( std::binary_search(inUse.begin(), inUse.end(), dqmIt->second) )
+        ++dqmIt;
+      else
+        dqmEventMap_.erase(dqmIt++);
+    }
+  }
+  
+  
+  void DataRetrieverMonitorCollection::EventTypeMqMap::
+  reset()
   {
     for (EventMap::iterator it = eventMap_.begin(),
            itEnd = eventMap_.end(); it != itEnd; ++it)
     {
-      it->second->size_.calculateStatistics();
-      it->second->corruptedEvents_.calculateStatistics();
+      it->second->reset();
     }
     for (DQMEventMap::iterator it = dqmEventMap_.begin(),
            itEnd = dqmEventMap_.end(); it != itEnd; ++it)
     {
-      it->second->size_.calculateStatistics();
-      it->second->corruptedEvents_.calculateStatistics();
+      it->second->reset();
     }
   }
   
@@ -350,65 +605,25 @@ namespace smproxy {
   }
   
   
-  bool DataRetrieverMonitorCollection::EventTypeMqMap::
+  DataRetrieverMonitorCollection::EventMQPtr
+  DataRetrieverMonitorCollection::EventTypeMqMap::
   insert(const stor::EventConsRegPtr eventConsumer)
   {
-    if ( eventConsumer == 0 ) return false;
-    eventMap_.insert(EventMap::value_type(eventConsumer,
+    if ( eventConsumer == 0 ) return EventMQPtr();
+    return eventMap_.insert(EventMap::value_type(eventConsumer,
         EventMQPtr( new EventMQ(updateInterval_) )
-      ));
-    return true;
+      )).first->second;
   }
   
   
-  bool DataRetrieverMonitorCollection::EventTypeMqMap::
+  DataRetrieverMonitorCollection::EventMQPtr
+  DataRetrieverMonitorCollection::EventTypeMqMap::
   insert(const stor::DQMEventConsRegPtr dqmEventConsumer)
   {
-    if ( dqmEventConsumer == 0 ) return false;
-    dqmEventMap_.insert(DQMEventMap::value_type(dqmEventConsumer,
+    if ( dqmEventConsumer == 0 ) return EventMQPtr();
+    return dqmEventMap_.insert(DQMEventMap::value_type(dqmEventConsumer,
         EventMQPtr( new EventMQ(updateInterval_) )
-      ));
-    return true;
-  }
-  
-  
-  bool DataRetrieverMonitorCollection::EventTypeMqMap::
-  addSample(const stor::EventConsRegPtr eventConsumer, const double& sizeKB)
-  {
-    if ( eventConsumer == 0 ) return false;
-    EventMap::const_iterator pos = eventMap_.find(eventConsumer);
-    pos->second->size_.addSample(sizeKB);
-    return true;
-  }
-  
-  
-  bool DataRetrieverMonitorCollection::EventTypeMqMap::
-  addSample(const stor::DQMEventConsRegPtr dqmEventConsumer, const double& sizeKB)
-  {
-    if ( dqmEventConsumer == 0 ) return false;
-    DQMEventMap::const_iterator pos = dqmEventMap_.find(dqmEventConsumer);
-    pos->second->size_.addSample(sizeKB);
-    return true;
-  }
-  
-  
-  bool DataRetrieverMonitorCollection::EventTypeMqMap::
-  receivedCorruptedEvent(const stor::EventConsRegPtr eventConsumer)
-  {
-    if ( eventConsumer == 0 ) return false;
-    EventMap::const_iterator pos = eventMap_.find(eventConsumer);
-    pos->second->corruptedEvents_.addSample(1);
-    return true;
-  }
-  
-  
-  bool DataRetrieverMonitorCollection::EventTypeMqMap::
-  receivedCorruptedEvent(const stor::DQMEventConsRegPtr dqmEventConsumer)
-  {
-    if ( dqmEventConsumer == 0 ) return false;
-    DQMEventMap::const_iterator pos = dqmEventMap_.find(dqmEventConsumer);
-    pos->second->corruptedEvents_.addSample(1);
-    return true;
+      )).first->second;
   }
   
   
@@ -441,7 +656,8 @@ namespace smproxy {
     const stor::utils::Duration_t& updateInterval
   ):
   size_(updateInterval, boost::posix_time::seconds(60)),
-  corruptedEvents_(updateInterval, boost::posix_time::seconds(60))
+  corruptedEvents_(updateInterval, boost::posix_time::seconds(60)),
+  discardedEvents_(updateInterval, boost::posix_time::seconds(60))
   {}
 
 
@@ -449,6 +665,7 @@ namespace smproxy {
   {
     size_.getStats(stats.sizeStats);
     corruptedEvents_.getStats(stats.corruptedEventsStats);
+    discardedEvents_.getStats(stats.discardedEventsStats);
   }
   
   
@@ -456,6 +673,7 @@ namespace smproxy {
   {
     size_.calculateStatistics();
     corruptedEvents_.calculateStatistics();
+    discardedEvents_.calculateStatistics();
   }
   
   
@@ -463,6 +681,67 @@ namespace smproxy {
   {
     size_.reset();
     corruptedEvents_.reset();
+    discardedEvents_.reset();
+  }
+  
+  
+  DataRetrieverMonitorCollection::PipelineStageMQ::PipelineStageMQ
+  (
+    const stor::utils::Duration_t& updateInterval
+  ):
+  occupancy_(updateInterval, boost::posix_time::seconds(60)),
+  stallTime_(updateInterval, boost::posix_time::seconds(60))
+  {}
+
+
+  void DataRetrieverMonitorCollection::PipelineStageMQ::getStats(PipelineStageStats& stats) const
+  {
+    occupancy_.getStats(stats.occupancyStats);
+    stallTime_.getStats(stats.stallTimeStats);
+  }
+  
+  
+  void DataRetrieverMonitorCollection::PipelineStageMQ::calculateStatistics()
+  {
+    occupancy_.calculateStatistics();
+    stallTime_.calculateStatistics();
+  }
+  
+  
+  void DataRetrieverMonitorCollection::PipelineStageMQ::reset()
+  {
+    occupancy_.reset();
+    stallTime_.reset();
+  }
+  
+  
+  DataRetrieverMonitorCollection::PriorityClassMQ::PriorityClassMQ
+  (
+    const stor::utils::Duration_t& updateInterval
+  ):
+  servedEvents_(updateInterval, boost::posix_time::seconds(60)),
+  shedEvents_(updateInterval, boost::posix_time::seconds(60))
+  {}
+
+
+  void DataRetrieverMonitorCollection::PriorityClassMQ::getStats(PriorityClassStats& stats) const
+  {
+    servedEvents_.getStats(stats.servedEventsStats);
+    shedEvents_.getStats(stats.shedEventsStats);
+  }
+  
+  
+  void DataRetrieverMonitorCollection::PriorityClassMQ::calculateStatistics()
+  {
+    servedEvents_.calculateStatistics();
+    shedEvents_.calculateStatistics();
+  }
+  
+  
+  void DataRetrieverMonitorCollection::PriorityClassMQ::reset()
+  {
+    servedEvents_.reset();
+    shedEvents_.reset();
   }
   
   
@@ -473,7 +752,8 @@ namespace smproxy {
   ):
   regPtr_(regPtr),
   connectionStatus_(UNKNOWN),
-  eventMQ_(new EventMQ(updateInterval))
+  eventMQ_(new EventMQ(updateInterval)),
+  removalTime_(boost::posix_time::pos_infin)
   {}
   
 } // namespace smproxy
@@ -496,6 +776,9 @@ std::ostream& smproxy::operator<<
     case DataRetrieverMonitorCollection::DISCONNECTED :
       os << "Lost connection to SM. Did it fail?";
       break;
+    case DataRetrieverMonitorCollection::CLOSED :
+      os << "Connection closed";
+      break;
     case DataRetrieverMonitorCollection::UNKNOWN :
       os << "unknown";
       break;
@@ -0,0 +1,142 @@
+// $Id$
+/// @file: EventCapture.cc
+
+#include "EventFilter/SMProxyServer/interface/EventCapture.h"
+#include "EventFilter/SMProxyServer/interface/Exception.h"
+
+#include <cerrno>
+#include <cstring>
+#include <sstream>
+
+
+namespace
+{
+  const char captureMagic[8] = { 'S','M','P','S','C','A','P','1' };
+
+  struct RecordHeader
+  {
+    uint32_t length;
+    uint32_t connectionId;
+    uint64_t offset;
+  };
+}
+
+
+namespace smproxy
+{
+  EventCapture::EventCapture
+  (
+    const std::string& fileName,
+    const size_t maxSize
+  ) :
+  fileName_(fileName),
+  maxSize_(maxSize),
+  startTime_(stor::utils::getCurrentTime()),
+  file_(0),
+  size_(0)
+  {
+    file_ = fopen(fileName_.c_str(), "wb");
+    if ( ! file_ || fwrite(captureMagic, sizeof(captureMagic), 1, file_) != 1 )
+    {
+      std::ostringstream msg;
+      msg << "Failed to create capture file " << fileName_ << ": " << strerror(errno);
+      if ( file_ ) fclose(file_);
+      XCEPT_RAISE(exception::EventCapture, msg.str());
+    }
+    size_ = sizeof(captureMagic);
+  }
+  
+  
+  EventCapture::~EventCapture()
+  {
+    fclose(file_);
+  }
+  
+  
+  bool EventCapture::write
+  (
+    const ConnectionID& connectionId,
+    const stor::CurlInterface::Content& data
+  )
+  {
+    const size_t recordSize = sizeof(RecordHeader) + data.size();
+    if ( size_ + recordSize > maxSize_ ) return false;
+
+    RecordHeader header;
+    header.length = data.size();
+    header.connectionId = connectionId.value;
+    header.offset =
+      (stor::utils::getCurrentTime() - startTime_).total_microseconds();
+
+    if (
+      fwrite(&header, sizeof(header), 1, file_) != 1 ||
+      ( ! data.empty() && fwrite(&data[0], data.size(), 1, file_) != 1 )
+    )
+    {
+      std::ostringstream msg;
+      msg << "Failed to write to capture file " << fileName_ << ": " << strerror(errno);
+      XCEPT_RAISE(exception::EventCapture, msg.str());
+    }
+    size_ += recordSize;
+
+    return true;
+  }
+  
+  
+  EventCaptureReader::EventCaptureReader(const std::string& fileName) :
+  fileName_(fileName),
+  file_(fopen(fileName.c_str(), "rb"))
+  {
+    if ( ! file_ )
+    {
+      std::ostringstream msg;
+      msg << "Failed to open capture file " << fileName_ << ": " << strerror(errno);
+      XCEPT_RAISE(exception::EventCapture, msg.str());
+    }
+
+    char magic[sizeof(captureMagic)];
+    if (
+      fread(magic, sizeof(magic), 1, file_) != 1 ||
+      memcmp(magic, captureMagic, sizeof(magic)) != 0
+    )
+    {
+      fclose(file_);
+      XCEPT_RAISE(exception::EventCapture, fileName_ + " is not a capture file");
+    }
+  }
+  
+  
+  EventCaptureReader::~EventCaptureReader()
+  {
+    fclose(file_);
+  }
+  
+  
+  bool EventCaptureReader::next(CapturedMessage& message)
+  {
+    RecordHeader header;
+    if ( fread(&header, sizeof(header), 1, file_) != 1 ) return false;
+
+    message.offset = header.offset;
+    message.connectionId = ConnectionID(header.connectionId);
+    message.data.resize(header.length);
+
+    return ( header.length == 0 ||
+      fread(&message.data[0], header.length, 1, file_) == 1 );
+  }
+  
+  
+  void EventCaptureReader::rewind()
+  {
+    fseek(file_, sizeof(captureMagic), SEEK_SET);
+  }
+
+} // namespace smproxy
+
+
+/// emacs configuration
+/// Local Variables: -
+/// mode: c++ -
+/// c-basic-offset: 2 -
+/// indent-tabs-mode: nil -
+/// End: -
@@ -0,0 +1,195 @@
+// $Id$
+/// @file: EventQueueCollection.cc
+
+#include "EventFilter/SMProxyServer/interface/EventQueueCollection.h"
+
+#include <set>
+
+
+namespace smproxy
+{
+  EventQueueCollection::EventQueueCollection
+  (
+    stor::ConsumerMonitorCollection& consumerMonitorCollection,
+    const stor::utils::Duration_t& expiryResolution
+  ) :
+  Base(consumerMonitorCollection),
+  expiryWheel_(expiryResolution)
+  {}
+
+
+  stor::QueueID EventQueueCollection::createQueue
+  (
+    const stor::RegPtr regPtr,
+    const stor::utils::TimePoint_t& now
+  )
+  {
+    const stor::QueueID queueId = Base::createQueue(regPtr, now);
+    if ( ! queueId.isValid() ) return queueId;
+
+    boost::mutex::scoped_lock sl(expiryMutex_);
+
+    QueueExpiry queueExpiry;
+    queueExpiry.secondsToStale = regPtr->secondsToStale();
+    queueExpiry.active = false;
+    queueExpiries_.insert(QueueExpiries::value_type(queueId, queueExpiry));
+    queueIDsByConsumerID_[regPtr->consumerId()] = queueId;
+
+    setActive(queueId, now);
+
+    return queueId;
+  }
+
+
+  void EventQueueCollection::removeQueues()
+  {
+    Base::removeQueues();
+
+    boost::mutex::scoped_lock sl(expiryMutex_);
+
+    for ( QueueExpiries::const_iterator it = queueExpiries_.begin(),
+            itEnd = queueExpiries_.end(); it != itEnd; ++it )
+    {
+      if ( it->second.active && it->second.activeConsumers )
+      {
+        boost::mutex::scoped_lock counterLock(it->second.activeConsumers->mutex_);
+        --(it->second.activeConsumers->count_);
+      }
+    }
+    queueExpiries_.clear();
+    queueIDsByConsumerID_.clear();
+    expiryWheel_.clear();
+  }
+
+
+  EventQueueCollection::ValueType
+  EventQueueCollection::popEvent(const stor::ConsumerID& consumerId)
+  {
+    const ValueType event = Base::popEvent(consumerId);
+
+    boost::mutex::scoped_lock sl(expiryMutex_);
+
+    QueueIDsByConsumerID::const_iterator pos = queueIDsByConsumerID_.find(consumerId);
+    if ( pos != queueIDsByConsumerID_.end() )
+      setActive(pos->second, stor::utils::getCurrentTime());
+
+    return event;
+  }
+
+
+  bool EventQueueCollection::stale
+  (
+    const stor::QueueID& queueId,
+    const stor::utils::TimePoint_t& now
+  )
+  {
+    {
+      boost::mutex::scoped_lock sl(expiryMutex_);
+
+      QueueExpiries::const_iterator pos = queueExpiries_.find(queueId);
+      if ( pos != queueExpiries_.end() )
+        return ( now > pos->second.deadline );
+    }
+
+    return Base::stale(queueId, now);
+  }
+
+
+  void EventQueueCollection::clearStaleQueues(const stor::utils::TimePoint_t& now)
+  {
+    stor::QueueIDs expired;
+
+    {
+      boost::mutex::scoped_lock sl(expiryMutex_);
+
+      expiryWheel_.expire(now, expired);
+
+      for ( stor::QueueIDs::const_iterator it = expired.begin(), itEnd = expired.end();
+            it != itEnd; ++it )
+      {
+        QueueExpiries::iterator pos = queueExpiries_.find(*it);
+        if ( pos == queueExpiries_.end() ) continue;
+
+        if ( pos->second.active && pos->second.activeConsumers )
+        {
+          boost::mutex::scoped_lock counterLock(pos->second.activeConsumers->mutex_);
+          --(pos->second.activeConsumers->count_);
+        }
+        queueExpiries_.erase(pos);
+      }
+
+      // Several consumers might share a queue. Expiries are rare.
+      // Thus, the whole map is scanned for the consumers of the queues.
+      if ( ! expired.empty() )
+      {
+        const std::set<stor::QueueID> expiredQueues(expired.begin(), expired.end());
+        QueueIDsByConsumerID::iterator it = queueIDsByConsumerID_.begin();
+        while ( it != queueIDsByConsumerID_.end() )
+        {
+          if ( expiredQueues.count(it->second) )
+            queueIDsByConsumerID_.erase(it++);
+          else
+            ++it;
+        }
+      }
+    }
+
+    for ( stor::QueueIDs::const_iterator it = expired.begin(), itEnd = expired.end();
+          it != itEnd; ++it )
+    {
+      clearQueue(*it);
+    }
+  }
+
+
+  void EventQueueCollection::attachActiveConsumers
+  (
+    const stor::QueueID& queueId,
+    ActiveConsumersPtr activeConsumers
+  )
+  {
+    boost::mutex::scoped_lock sl(expiryMutex_);
+
+    QueueExpiries::iterator pos = queueExpiries_.find(queueId);
+    if ( pos == queueExpiries_.end() || pos->second.activeConsumers ) return;
+
+    pos->second.activeConsumers = activeConsumers;
+    if ( pos->second.active )
+    {
+      boost::mutex::scoped_lock counterLock(activeConsumers->mutex_);
+      ++(activeConsumers->count_);
+    }
+  }
+
+
+  void EventQueueCollection::setActive
+  (
+    const stor::QueueID& queueId,
+    const stor::utils::TimePoint_t& now
+  )
+  {
+    QueueExpiries::iterator pos = queueExpiries_.find(queueId);
+    if ( pos == queueExpiries_.end() ) return;
+
+    pos->second.deadline = now + pos->second.secondsToStale;
+    expiryWheel_.schedule(queueId, pos->second.deadline);
+
+    if ( pos->second.active ) return;
+
+    pos->second.active = true;
+    if ( pos->second.activeConsumers )
+    {
+      boost::mutex::scoped_lock counterLock(pos->second.activeConsumers->mutex_);
+      ++(pos->second.activeConsumers->count_);
+    }
+  }
+
+} // namespace smproxy
+
+
+/// emacs configuration
+/// Local Variables: -
+/// mode: c++ -
+/// c-basic-offset: 2 -
+/// indent-tabs-mode: nil -
+/// End: -
@@ -0,0 +1,313 @@
+// $Id$
+/// @file: EventSpool.cc
+
+#include "EventFilter/SMProxyServer/interface/Checksum.h"
+#include "EventFilter/SMProxyServer/interface/EventSpool.h"
+#include "EventFilter/SMProxyServer/interface/Exception.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <map>
+#include <sstream>
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+namespace
+{
+  const uint32_t spoolMagic = 0x53504c32; // "SPL2"
+  const size_t recordAlignment = 8;
+}
+
+
+namespace smproxy
+{
+  EventSpool::EventSpool
+  (
+    const std::string& fileName,
+    const size_t size
+  ) :
+  fileName_(fileName),
+  size_(size - size % recordAlignment),
+  fd_(-1),
+  map_(0),
+  head_(0),
+  nextSequence_(1)
+  {
+    if ( size_ < recordSize(0) )
+    {
+      std::ostringstream msg;
+      msg << "Spool size of " << size << " Bytes is too small for " << fileName_;
+      XCEPT_RAISE(exception::EventSpool, msg.str());
+    }
+
+    fd_ = open(fileName_.c_str(), O_RDWR | O_CREAT, 0644);
+    if ( fd_ < 0 )
+    {
+      std::ostringstream msg;
+      msg << "Failed to open spool file " << fileName_ << ": " << strerror(errno);
+      XCEPT_RAISE(exception::EventSpool, msg.str());
+    }
+
+    // Each spool keeps its own write position and index.
+    // Thus, a file must never be written by two spools.
+    if ( flock(fd_, LOCK_EX | LOCK_NB) != 0 )
+    {
+      std::ostringstream msg;
+      if ( errno == EWOULDBLOCK )
+        msg << "Spool file " << fileName_ << " is already in use by another retriever or process";
+      else
+        msg << "Failed to lock spool file " << fileName_ << ": " << strerror(errno);
+      close(fd_);
+      XCEPT_RAISE(exception::EventSpool, msg.str());
+    }
+
+    struct stat fileStat;
+    const bool recoverEvents = ( fstat(fd_, &fileStat) == 0 &&
+      static_cast<size_t>(fileStat.st_size) == size_ );
+
+    if ( ! recoverEvents && ftruncate(fd_, size_) != 0 )
+    {
+      std::ostringstream msg;
+      msg << "Failed to resize spool file " << fileName_ << " to " << size_
+        << " Bytes: " << strerror(errno);
+      close(fd_);
+      XCEPT_RAISE(exception::EventSpool, msg.str());
+    }
+
+    void* map = mmap(0, size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+    if ( map == MAP_FAILED )
+    {
+      std::ostringstream msg;
+      msg << "Failed to map spool file " << fileName_ << ": " << strerror(errno);
+      close(fd_);
+      XCEPT_RAISE(exception::EventSpool, msg.str());
+    }
+    map_ = static_cast<unsigned char*>(map);
+
+    if ( recoverEvents ) recover();
+  }
+  
+  
+  EventSpool::~EventSpool()
+  {
+    munmap(map_, size_);
+    close(fd_);
+  }
+  
+  
+  bool EventSpool::append
+  (
+    const unsigned char* data,
+    const size_t length
+  )
+  {
+    const size_t size = recordSize(length);
+    if ( size > size_ ) return false;
+
+    boost::mutex::scoped_lock sl(mutex_);
+
+    if ( head_ + size > size_ )
+    {
+      // Invalidate the remainder of the file and wrap around
+      evict(head_, size_ - head_);
+      std::memset(map_ + head_, 0, size_ - head_);
+      head_ = 0;
+    }
+
+    evict(head_, size);
+
+    RecordHeader header;
+    header.magic = spoolMagic;
+    header.length = length;
+    header.sequence = nextSequence_++;
+    header.timestamp = toMicroseconds(stor::utils::getCurrentTime());
+    header.payloadChecksum = adler32(data, length);
+    header.reserved = 0;
+    header.checksum = checksum(header);
+
+    // Write the payload before the header such that an interrupted
+    // write never results in a valid record
+    std::memset(map_ + head_, 0, sizeof(RecordHeader));
+    std::memcpy(map_ + head_ + sizeof(RecordHeader), data, length);
+    std::memcpy(map_ + head_, &header, sizeof(RecordHeader));
+
+    Entry entry;
+    entry.sequence = header.sequence;
+    entry.timestamp = header.timestamp;
+    entry.offset = head_;
+    entry.recordSize = size;
+    index_.push_back(entry);
+
+    head_ += size;
+    if ( head_ == size_ ) head_ = 0;
+
+    return true;
+  }
+  
+  
+  uint64_t EventSpool::firstSequenceSince(const stor::utils::TimePoint_t& time) const
+  {
+    const uint64_t timestamp = toMicroseconds(time);
+
+    boost::mutex::scoped_lock sl(mutex_);
+
+    // The timestamps are monotonic in the spool order
+    for ( Index::const_reverse_iterator it = index_.rbegin(), itEnd = index_.rend();
+          it != itEnd; ++it )
+    {
+      if ( it->timestamp < timestamp ) return it->sequence + 1;
+    }
+    return index_.empty() ? nextSequence_ : index_.front().sequence;
+  }
+  
+  
+  bool EventSpool::read(uint64_t& sequence, Buffer& buffer) const
+  {
+    boost::mutex::scoped_lock sl(mutex_);
+
+    if ( index_.empty() || sequence > index_.back().sequence ) return false;
+
+    Index::const_iterator pos = index_.begin();
+    if ( sequence > pos->sequence )
+    {
+      // The sequence numbers are contiguous except for recovered spools
+      pos += std::min<uint64_t>(sequence - pos->sequence, index_.size() - 1);
+      while ( pos->sequence > sequence ) --pos;
+      while ( pos->sequence < sequence ) ++pos;
+    }
+
+    sequence = pos->sequence;
+    const RecordHeader* header =
+      reinterpret_cast<const RecordHeader*>(map_ + pos->offset);
+    const unsigned char* data = map_ + pos->offset + sizeof(RecordHeader);
+    buffer.assign(data, data + header->length);
+
+    return true;
+  }
+  
+  
+  size_t EventSpool::eventCount() const
+  {
+    boost::mutex::scoped_lock sl(mutex_);
+    return index_.size();
+  }
+  
+  
+  uint64_t EventSpool::checksum(const RecordHeader& header)
+  {
+    return ( (static_cast<uint64_t>(header.magic) << 32) | header.length ) ^
+      (header.sequence * 0x9e3779b97f4a7c15ULL) ^ ~header.timestamp ^
+      (static_cast<uint64_t>(header.payloadChecksum) << 16);
+  }
+  
+  
+  size_t EventSpool::recordSize(const size_t length)
+  {
+    const size_t size = sizeof(RecordHeader) + length;
+    return ( (size + recordAlignment - 1) / recordAlignment ) * recordAlignment;
+  }
+  
+  
+  uint64_t EventSpool::toMicroseconds(const stor::utils::TimePoint_t& time)
+  {
+    static const stor::utils::TimePoint_t epoch(boost::gregorian::date(1970,1,1));
+    return (time - epoch).total_microseconds();
+  }
+  
+  
+  bool EventSpool::validHeader(const size_t offset) const
+  {
+    if ( offset + sizeof(RecordHeader) > size_ ) return false;
+
+    RecordHeader header;
+    std::memcpy(&header, map_ + offset, sizeof(RecordHeader));
+
+    // The payload is only checked once the header has proven
+    // that the record length is sane
+    return ( header.magic == spoolMagic &&
+      header.checksum == checksum(header) &&
+      offset + recordSize(header.length) <= size_ &&
+      header.payloadChecksum == adler32(map_ + offset + sizeof(RecordHeader), header.length) );
+  }
+  
+  
+  void EventSpool::recover()
+  {
+    typedef std::map<uint64_t, Entry> Records;
+    Records records;
+
+    for (size_t offset = 0; offset + sizeof(RecordHeader) <= size_; offset += recordAlignment)
+    {
+      if ( ! validHeader(offset) ) continue;
+
+      const RecordHeader* header =
+        reinterpret_cast<const RecordHeader*>(map_ + offset);
+      Entry entry;
+      entry.sequence = header->sequence;
+      entry.timestamp = header->timestamp;
+      entry.offset = offset;
+      entry.recordSize = recordSize(header->length);
+      records[entry.sequence] = entry;
+    }
+
+    if ( records.empty() ) return;
+
+    // Starting from the newest record, only keep the chain of records
+    // written before it. Anything else has been partially overwritten.
+    Records::const_reverse_iterator it = records.rbegin();
+    index_.push_front(it->second);
+    head_ = it->second.offset + it->second.recordSize;
+    if ( head_ == size_ ) head_ = 0;
+    nextSequence_ = it->second.sequence + 1;
+
+    size_t expectedEnd = it->second.offset;
+    bool wrapped = ( head_ == 0 );
+
+    for ( ++it; it != records.rend(); ++it )
+    {
+      const Entry& entry = it->second;
+      const size_t end = entry.offset + entry.recordSize;
+
+      if ( expectedEnd == 0 && ! wrapped )
+      {
+        // the last record before the wrap around
+        if ( entry.offset < head_ ) break;
+        wrapped = true;
+      }
+      else if ( end != expectedEnd || ( wrapped && entry.offset < head_ ) )
+      {
+        break;
+      }
+
+      index_.push_front(entry);
+      expectedEnd = entry.offset;
+    }
+  }
+  
+  
+  void EventSpool::evict(const size_t offset, const size_t recordSize)
+  {
+    // The oldest records always follow the head of the ring
+    const size_t end = offset + recordSize;
+    while ( ! index_.empty() &&
+      index_.front().offset < end &&
+      index_.front().offset + index_.front().recordSize > offset )
+    {
+      index_.pop_front();
+    }
+  }
+
+} // namespace smproxy
+  
+/// emacs configuration
+/// Local Variables: -
+/// mode: c++ -
+/// c-basic-offset: 2 -
+/// indent-tabs-mode: nil -
+/// End: -
@@ -1,6 +1,7 @@
 // $Id: SMPSWebPageHelper.cc,v 1.2 2011/03/07 15:41:55 mommsen Exp $
 /// @file: SMPSWebPageHelper.cc
 
+#include "EventFilter/SMProxyServer/interface/ConsumerPriority.h"
 #include "EventFilter/SMProxyServer/interface/SMPSWebPageHelper.h"
 #include "EventFilter/StorageManager/interface/RegistrationCollection.h"
 #include "EventFilter/StorageManager/interface/Utils.h"
@@ -9,6 +10,9 @@
 
 #include <boost/pointer_cast.hpp>
 
+#include <sstream>
+#include <vector>
+
 
 namespace smproxy
 {
@@ -19,7 +23,7 @@ namespace smproxy
   ) :
   stor::WebPageHelper<SMPSWebPageHelper>(appDesc, "$Name:  $", this, &smproxy::SMPSWebPageHelper::addDOMforHyperLinks),
   stateMachine_(stateMachine),
-  consumerWebPageHelper_(appDesc, "$Name:  $", this, &smproxy::SMPSWebPageHelper::addDOMforHyperLinks)
+  consumerWebPageHelper_(appDesc, "$Name:  $", this, &smproxy::SMPSWebPageHelper::addDOMforConsumerPriorities)
   { }
   
   
@@ -68,6 +72,14 @@ namespace smproxy
     
     maker.addNode("hr", body);
     
+    addDOMforBandwidth(maker, body);
+    
+    maker.addNode("hr", body);
+    
+    addDOMforRetrievalPipeline(maker, body);
+    
+    maker.addNode("hr", body);
+    
     addDOMforDQMEventServers(maker, body);
     
     addDOMforHyperLinks(maker, body);
@@ -115,6 +127,120 @@ namespace smproxy
   } 
   
   
+  void SMPSWebPageHelper::threadStatisticsWebPage(xgi::Output* out) const
+  {
+    stor::XHTMLMonitor theMonitor;
+    stor::XHTMLMaker maker;
+
+    stor::XHTMLMaker::Node* body = createWebPageBody(maker,
+      "Thread Statistics",
+      stateMachine_->getExternallyVisibleStateName(),
+      stateMachine_->getStateName(),
+      stateMachine_->getReasonForFailed()
+    );
+
+    addDOMforThreads(maker, body);
+    
+    addDOMforHyperLinks(maker, body);
+    
+    // Dump the webpage to the output stream
+    maker.out(*out);    
+  }
+  
+  
+  void SMPSWebPageHelper::addDOMforConsumerPriorities
+  (
+    stor::XHTMLMaker& maker,
+    stor::XHTMLMaker::Node *parent
+  ) const
+  {
+    // count the registered consumers per priority class
+    const DataRetrieverParams& drp =
+      stateMachine_->getConfiguration()->getSnapshot()->dataRetrieverParams_;
+    std::vector<size_t> consumerCounts(PRIORITY_CLASSES, 0);
+
+    stor::RegistrationCollection::ConsumerRegistrations consumers;
+    stateMachine_->getRegistrationCollection()->getEventConsumers(consumers);
+    for (stor::RegistrationCollection::ConsumerRegistrations::const_iterator
+           it = consumers.begin(), itEnd = consumers.end(); it != itEnd; ++it)
+      ++consumerCounts[getConsumerPriority(*it, drp)];
+
+    stor::RegistrationCollection::DQMConsumerRegistrations dqmConsumers;
+    stateMachine_->getRegistrationCollection()->getDQMEventConsumers(dqmConsumers);
+    for (stor::RegistrationCollection::DQMConsumerRegistrations::const_iterator
+           it = dqmConsumers.begin(), itEnd = dqmConsumers.end(); it != itEnd; ++it)
+      ++consumerCounts[getConsumerPriority(*it, drp)];
+
+    DataRetrieverMonitorCollection::PriorityStats priorityStats;
+    stateMachine_->getStatisticsReporter()->getDataRetrieverMonitorCollection()
+      .getPriorityStats(priorityStats);
+
+    stor::XHTMLMaker::AttrMap colspanAttr;
+    colspanAttr[ "colspan" ] = "6";
+    
+    stor::XHTMLMaker::Node* table = maker.addNode("table", parent, tableAttr_);
+    
+    stor::XHTMLMaker::Node* tableRow = maker.addNode("tr", table, rowAttr_);
+    stor::XHTMLMaker::Node* tableDiv = maker.addNode("th", tableRow, colspanAttr);
+    maker.addText(tableDiv, "Consumer Priority Classes");
+    
+    stor::XHTMLMaker::AttrMap rowspanAttr;
+    rowspanAttr[ "rowspan" ] = "2";
+    
+    stor::XHTMLMaker::AttrMap subColspanAttr;
+    subColspanAttr[ "colspan" ] = "2";
+
+    stor::XHTMLMaker::AttrMap noWrapAttr; 
+    noWrapAttr[ "style" ] = "white-space: nowrap;";
+   
+    // Header
+    tableRow = maker.addNode("tr", table, specialRowAttr_);
+    tableDiv = maker.addNode("th", tableRow, rowspanAttr);
+    maker.addText(tableDiv, "Priority");
+    tableDiv = maker.addNode("th", tableRow, rowspanAttr);
+    maker.addText(tableDiv, "Consumers");
+    tableDiv = maker.addNode("th", tableRow, subColspanAttr);
+    maker.addText(tableDiv, "Events Served (Hz)");
+    tableDiv = maker.addNode("th", tableRow, subColspanAttr);
+    maker.addText(tableDiv, "Events Shed (Hz)");
+
+    tableRow = maker.addNode("tr", table, specialRowAttr_);
+    tableDiv = maker.addNode("th", tableRow);
+    maker.addText(tableDiv, "overall");
+    tableDiv = maker.addNode("th", tableRow, noWrapAttr);
+    maker.addText(tableDiv, "last 60 s");
+    tableDiv = maker.addNode("th", tableRow);
+    maker.addText(tableDiv, "overall");
+    tableDiv = maker.addNode("th", tableRow, noWrapAttr);
+    maker.addText(tableDiv, "last 60 s");
+
+    for (int priority = HIGH_PRIORITY; priority < PRIORITY_CLASSES; ++priority)
+    {
+      const DataRetrieverMonitorCollection::PriorityClassStats& stats =
+        priorityStats[priority];
+
+      std::ostringstream priorityName;
+      priorityName << static_cast<ConsumerPriority>(priority);
+
+      tableRow = maker.addNode("tr", table, rowAttr_);
+      tableDiv = maker.addNode("td", tableRow);
+      maker.addText(tableDiv, priorityName.str());
+      tableDiv = maker.addNode("td", tableRow, tableValueAttr_);
+      maker.addInt(tableDiv, consumerCounts[priority]);
+      tableDiv = maker.addNode("td", tableRow, tableValueAttr_);
+      maker.addDouble(tableDiv, stats.servedEventsStats.getValueRate(stor::MonitoredQuantity::FULL), 1);
+      tableDiv = maker.addNode("td", tableRow, tableValueAttr_);
+      maker.addDouble(tableDiv, stats.servedEventsStats.getValueRate(stor::MonitoredQuantity::RECENT), 1);
+      tableDiv = maker.addNode("td", tableRow, tableValueAttr_);
+      maker.addDouble(tableDiv, stats.shedEventsStats.getValueRate(stor::MonitoredQuantity::FULL), 1);
+      tableDiv = maker.addNode("td", tableRow, tableValueAttr_);
+      maker.addDouble(tableDiv, stats.shedEventsStats.getValueRate(stor::MonitoredQuantity::RECENT), 1);
+    }
+
+    addDOMforHyperLinks(maker, parent);
+  }
+  
+  
   void SMPSWebPageHelper::addDOMforHyperLinks
   (
     stor::XHTMLMaker& maker,
@@ -152,6 +278,12 @@ namespace smproxy
     maker.addText(link, "Consumer Statistics");
     
     maker.addNode("hr", parent);
+    
+    linkAttr[ "href" ] = url + "/threadStatistics";
+    link = maker.addNode("a", parent, linkAttr);
+    maker.addText(link, "Thread Statistics");
+    
+    maker.addNode("hr", parent);
   }
   
   
@@ -183,7 +315,7 @@ namespace smproxy
     maker.addText(tableDiv, "# of configured StorageManagers");
     tableDiv = maker.addNode("td", tableRow, tableValueAttr_);
     const size_t configuredSMs = stateMachine_->getConfiguration()->
-      getDataRetrieverParams().smRegistrationList_.size();
+      getSnapshot()->dataRetrieverParams_.smRegistrationList_.size();
     maker.addInt(tableDiv, configuredSMs);
 
     // # of requested SMs connections
@@ -512,7 +644,7 @@ namespace smproxy
   ) const
   {
     stor::XHTMLMaker::AttrMap colspanAttr;
-    colspanAttr[ "colspan" ] = "14";
+    colspanAttr[ "colspan" ] = "16";
     
     stor::XHTMLMaker::Node* table = maker.addNode("table", parent, tableAttr_);
     
@@ -549,6 +681,8 @@ namespace smproxy
     maker.addText(tableDiv, "Corrupted Events");
     tableDiv = maker.addNode("th", tableRow, subColspanAttr);
     maker.addText(tableDiv, "Corrupted Event Rate (Hz)");
+    tableDiv = maker.addNode("th", tableRow, subColspanAttr);
+    maker.addText(tableDiv, "Discarded Event Rate (Hz)");
 
     tableRow = maker.addNode("tr", table, specialRowAttr_);
     tableDiv = maker.addNode("th", tableRow);
@@ -571,6 +705,10 @@ namespace smproxy
     maker.addText(tableDiv, "overall");
     tableDiv = maker.addNode("th", tableRow, noWrapAttr);
     maker.addText(tableDiv, "last 60 s");
+    tableDiv = maker.addNode("th", tableRow);
+    maker.addText(tableDiv, "overall");
+    tableDiv = maker.addNode("th", tableRow, noWrapAttr);
+    maker.addText(tableDiv, "last 60 s");
 
     DataRetrieverMonitorCollection::EventTypePerConnectionStatList eventTypePerConnectionStats;
     stateMachine_->getStatisticsReporter()->getDataRetrieverMonitorCollection()
@@ -622,6 +760,304 @@ namespace smproxy
   }
   
   
+  void SMPSWebPageHelper::addDOMforBandwidth
+  (
+    stor::XHTMLMaker& maker,
+    stor::XHTMLMaker::Node* parent
+  ) const
+  {
+    stor::XHTMLMaker::AttrMap colspanAttr;
+    colspanAttr[ "colspan" ] = "5";
+    
+    stor::XHTMLMaker::Node* table = maker.addNode("table", parent, tableAttr_);
+    
+    stor::XHTMLMaker::Node* tableRow = maker.addNode("tr", table, rowAttr_);
+    stor::XHTMLMaker::Node* tableDiv = maker.addNode("th", tableRow, colspanAttr);
+    maker.addText(tableDiv, "Upstream Bandwidth");
+    
+    stor::XHTMLMaker::AttrMap rowspanAttr;
+    rowspanAttr[ "rowspan" ] = "2";
+    
+    stor::XHTMLMaker::AttrMap subColspanAttr;
+    subColspanAttr[ "colspan" ] = "2";
+
+    stor::XHTMLMaker::AttrMap noWrapAttr; 
+    noWrapAttr[ "style" ] = "white-space: nowrap;";
+   
+    // Header
+    tableRow = maker.addNode("tr", table, specialRowAttr_);
+    tableDiv = maker.addNode("th", tableRow, rowspanAttr);
+    maker.addText(tableDiv, "Hostname");
+    tableDiv = maker.addNode("th", tableRow, rowspanAttr);
+    maker.addText(tableDiv, "Cap (MB/s)");
+    tableDiv = maker.addNode("th", tableRow, subColspanAttr);
+    maker.addText(tableDiv, "Bandwidth (MB/s)");
+    tableDiv = maker.addNode("th", tableRow, rowspanAttr);
+    maker.addText(tableDiv, "Cap Used (%)");
+
+    tableRow = maker.addNode("tr", table, specialRowAttr_);
+    tableDiv = maker.addNode("th", tableRow);
+    maker.addText(tableDiv, "overall");
+    tableDiv = maker.addNode("th", tableRow, noWrapAttr);
+    maker.addText(tableDiv, "last 60 s");
+
+    const BandwidthLimiterPtr bandwidthLimiter = stateMachine_->getBandwidthLimiter();
+    const double limitPerSM = bandwidthLimiter->limitPerSM();
+
+    DataRetrieverMonitorCollection::ConnectionStats connectionStats;
+    stateMachine_->getStatisticsReporter()->getDataRetrieverMonitorCollection()
+      .getStatsByConnection(connectionStats);
+
+    for (DataRetrieverMonitorCollection::ConnectionStats::const_iterator
+           it = connectionStats.begin(), itEnd = connectionStats.end();
+         it != itEnd; ++it)
+    {
+      tableRow = maker.addNode("tr", table, rowAttr_);
+      addDOMforSMhost(maker, tableRow, it->first);
+      addRowForBandwidth(maker, tableRow, it->second, limitPerSM);
+    }
+
+    DataRetrieverMonitorCollection::SummaryStats summaryStats;
+    stateMachine_->getStatisticsReporter()->getDataRetrieverMonitorCollection()
+      .getSummaryStats(summaryStats);
+
+    tableRow = maker.addNode("tr", table, specialRowAttr_);
+    tableDiv = maker.addNode("td", tableRow);
+    maker.addText(tableDiv, "Total");
+    addRowForBandwidth(maker, tableRow, summaryStats.totals, bandwidthLimiter->limit());
+  }
+  
+  
+  void SMPSWebPageHelper::addRowForBandwidth
+  (
+    stor::XHTMLMaker& maker,
+    stor::XHTMLMaker::Node* tableRow,
+    DataRetrieverMonitorCollection::EventStats const& stats,
+    const double& limit
+  ) const
+  {
+    // Cap
+    stor::XHTMLMaker::Node* tableDiv = maker.addNode("td", tableRow, tableValueAttr_);
+    if ( limit > 0 )
+      maker.addDouble(tableDiv, limit / (1024*1024));
+    else
+      maker.addText(tableDiv, "unlimited");
+
+    // Bandwidth: the size statistics are in kB
+    const double recentRate =
+      stats.sizeStats.getValueRate(stor::MonitoredQuantity::RECENT) / 1024;
+    tableDiv = maker.addNode("td", tableRow, tableValueAttr_);
+    maker.addDouble(tableDiv, stats.sizeStats.getValueRate(stor::MonitoredQuantity::FULL) / 1024);
+    tableDiv = maker.addNode("td", tableRow, tableValueAttr_);
+    maker.addDouble(tableDiv, recentRate);
+
+    // Fraction of the cap used
+    tableDiv = maker.addNode("td", tableRow, tableValueAttr_);
+    if ( limit > 0 )
+      maker.addDouble(tableDiv, 100 * recentRate * 1024 * 1024 / limit, 1);
+    else
+      maker.addText(tableDiv, "-");
+  }
+  
+  
+  void SMPSWebPageHelper::addDOMforRetrievalPipeline
+  (
+    stor::XHTMLMaker& maker,
+    stor::XHTMLMaker::Node* parent
+  ) const
+  {
+    stor::XHTMLMaker::AttrMap colspanAttr;
+    colspanAttr[ "colspan" ] = "5";
+    
+    stor::XHTMLMaker::Node* table = maker.addNode("table", parent, tableAttr_);
+    
+    stor::XHTMLMaker::Node* tableRow = maker.addNode("tr", table, rowAttr_);
+    stor::XHTMLMaker::Node* tableDiv = maker.addNode("th", tableRow, colspanAttr);
+    maker.addText(tableDiv, "Data Event Retrieval Pipeline");
+    
+    stor::XHTMLMaker::AttrMap rowspanAttr;
+    rowspanAttr[ "rowspan" ] = "2";
+    
+    stor::XHTMLMaker::AttrMap subColspanAttr;
+    subColspanAttr[ "colspan" ] = "2";
+
+    stor::XHTMLMaker::AttrMap noWrapAttr; 
+    noWrapAttr[ "style" ] = "white-space: nowrap;";
+   
+    // Header
+    tableRow = maker.addNode("tr", table, specialRowAttr_);
+    tableDiv = maker.addNode("th", tableRow, rowspanAttr);
+    maker.addText(tableDiv, "Stage");
+    tableDiv = maker.addNode("th", tableRow, subColspanAttr);
+    maker.addText(tableDiv, "Average Input Queue Occupancy (events)");
+    tableDiv = maker.addNode("th", tableRow, subColspanAttr);
+    maker.addText(tableDiv, "Stall Time (%)");
+
+    tableRow = maker.addNode("tr", table, specialRowAttr_);
+    tableDiv = maker.addNode("th", tableRow);
+    maker.addText(tableDiv, "overall");
+    tableDiv = maker.addNode("th", tableRow, noWrapAttr);
+    maker.addText(tableDiv, "last 60 s");
+    tableDiv = maker.addNode("th", tableRow);
+    maker.addText(tableDiv, "overall");
+    tableDiv = maker.addNode("th", tableRow, noWrapAttr);
+    maker.addText(tableDiv, "last 60 s");
+
+    DataRetrieverMonitorCollection::PipelineStats pipelineStats;
+    stateMachine_->getStatisticsReporter()->getDataRetrieverMonitorCollection()
+      .getPipelineStats(pipelineStats);
+
+    const char* stageNames[] = { "Fetch", "Build", "Enqueue" };
+
+    for (int stage = DataRetrieverMonitorCollection::FETCH_STAGE;
+         stage < DataRetrieverMonitorCollection::PIPELINE_STAGES; ++stage)
+    {
+      const DataRetrieverMonitorCollection::PipelineStageStats& stats =
+        pipelineStats[stage];
+
+      tableRow = maker.addNode("tr", table, rowAttr_);
+      tableDiv = maker.addNode("td", tableRow);
+      maker.addText(tableDiv, stageNames[stage]);
+
+      if ( stage == DataRetrieverMonitorCollection::FETCH_STAGE )
+      {
+        // The fetch stage reads from the network
+        tableDiv = maker.addNode("td", tableRow, tableValueAttr_);
+        maker.addText(tableDiv, "n/a");
+        tableDiv = maker.addNode("td", tableRow, tableValueAttr_);
+        maker.addText(tableDiv, "n/a");
+      }
+      else
+      {
+        tableDiv = maker.addNode("td", tableRow, tableValueAttr_);
+        maker.addDouble(tableDiv, stats.occupancyStats.getValueAverage(stor::MonitoredQuantity::FULL), 1);
+        tableDiv = maker.addNode("td", tableRow, tableValueAttr_);
+        maker.addDouble(tableDiv, stats.occupancyStats.getValueAverage(stor::MonitoredQuantity::RECENT), 1);
+      }
+
+      tableDiv = maker.addNode("td", tableRow, tableValueAttr_);
+      maker.addDouble(tableDiv, 100 * stats.stallTimeStats.getValueRate(stor::MonitoredQuantity::FULL), 1);
+      tableDiv = maker.addNode("td", tableRow, tableValueAttr_);
+      maker.addDouble(tableDiv, 100 * stats.stallTimeStats.getValueRate(stor::MonitoredQuantity::RECENT), 1);
+    }
+  }
+  
+  
+  void SMPSWebPageHelper::addDOMforThreads
+  (
+    stor::XHTMLMaker& maker,
+    stor::XHTMLMaker::Node* parent
+  ) const
+  {
+    std::ostringstream colspan;
+    colspan << 5 + ThreadMonitorCollection::WAIT_POINTS;
+
+    stor::XHTMLMaker::AttrMap colspanAttr;
+    colspanAttr[ "colspan" ] = colspan.str();
+    
+    stor::XHTMLMaker::Node* table = maker.addNode("table", parent, tableAttr_);
+    
+    stor::XHTMLMaker::Node* tableRow = maker.addNode("tr", table, rowAttr_);
+    stor::XHTMLMaker::Node* tableDiv = maker.addNode("th", tableRow, colspanAttr);
+    maker.addText(tableDiv, "Threads");
+    
+    stor::XHTMLMaker::AttrMap rowspanAttr;
+    rowspanAttr[ "rowspan" ] = "2";
+    
+    stor::XHTMLMaker::AttrMap subColspanAttr;
+    subColspanAttr[ "colspan" ] = "2";
+
+    std::ostringstream waitColspan;
+    waitColspan << ThreadMonitorCollection::WAIT_POINTS;
+
+    stor::XHTMLMaker::AttrMap waitColspanAttr;
+    waitColspanAttr[ "colspan" ] = waitColspan.str();
+
+    stor::XHTMLMaker::AttrMap noWrapAttr; 
+    noWrapAttr[ "style" ] = "white-space: nowrap;";
+   
+    // Header
+    tableRow = maker.addNode("tr", table, specialRowAttr_);
+    tableDiv = maker.addNode("th", tableRow, rowspanAttr);
+    maker.addText(tableDiv, "Thread");
+    tableDiv = maker.addNode("th", tableRow, subColspanAttr);
+    maker.addText(tableDiv, "CPU Usage (%)");
+    tableDiv = maker.addNode("th", tableRow, subColspanAttr);
+    maker.addText(tableDiv, "Context Switches last 60 s (Hz)");
+    tableDiv = maker.addNode("th", tableRow, waitColspanAttr);
+    maker.addText(tableDiv, "Time Blocked last 60 s (%)");
+
+    tableRow = maker.addNode("tr", table, specialRowAttr_);
+    tableDiv = maker.addNode("th", tableRow);
+    maker.addText(tableDiv, "overall");
+    tableDiv = maker.addNode("th", tableRow, noWrapAttr);
+    maker.addText(tableDiv, "last 60 s");
+    tableDiv = maker.addNode("th", tableRow);
+    maker.addText(tableDiv, "voluntary");
+    tableDiv = maker.addNode("th", tableRow);
+    maker.addText(tableDiv, "involuntary");
+    for (int waitPoint = 0; waitPoint < ThreadMonitorCollection::WAIT_POINTS; ++waitPoint)
+    {
+      tableDiv = maker.addNode("th", tableRow, noWrapAttr);
+      maker.addText(tableDiv, ThreadMonitorCollection::waitPointName(
+          static_cast<ThreadMonitorCollection::WaitPoint>(waitPoint)));
+    }
+
+    ThreadMonitorCollection::ThreadStatList threadStats;
+    stateMachine_->getStatisticsReporter()->getThreadMonitorCollection()
+      .getStats(threadStats);
+
+    if ( threadStats.empty() )
+    {
+      tableRow = maker.addNode("tr", table, rowAttr_);
+      tableDiv = maker.addNode("td", tableRow, colspanAttr);
+      maker.addText(tableDiv, "No threads are monitored");
+      return;
+    }
+
+    for (ThreadMonitorCollection::ThreadStatList::const_iterator
+           it = threadStats.begin(), itEnd = threadStats.end();
+         it != itEnd; ++it)
+    {
+      addRowForThread(maker, table, *it);
+    }
+  }
+  
+  
+  void SMPSWebPageHelper::addRowForThread
+  (
+    stor::XHTMLMaker& maker,
+    stor::XHTMLMaker::Node* table,
+    ThreadMonitorCollection::ThreadStats const& stats
+  ) const
+  {
+    stor::XHTMLMaker::Node* tableRow = maker.addNode("tr", table, rowAttr_);
+
+    stor::XHTMLMaker::Node* tableDiv = maker.addNode("td", tableRow);
+    maker.addText(tableDiv, stats.name);
+
+    // CPU usage
+    tableDiv = maker.addNode("td", tableRow, tableValueAttr_);
+    maker.addDouble(tableDiv, 100 * stats.cpuTimeStats.getValueRate(stor::MonitoredQuantity::FULL), 1);
+    tableDiv = maker.addNode("td", tableRow, tableValueAttr_);
+    maker.addDouble(tableDiv, 100 * stats.cpuTimeStats.getValueRate(stor::MonitoredQuantity::RECENT), 1);
+
+    // Context switches
+    tableDiv = maker.addNode("td", tableRow, tableValueAttr_);
+    maker.addDouble(tableDiv, stats.voluntarySwitchStats.getValueRate(stor::MonitoredQuantity::RECENT), 1);
+    tableDiv = maker.addNode("td", tableRow, tableValueAttr_);
+    maker.addDouble(tableDiv, stats.involuntarySwitchStats.getValueRate(stor::MonitoredQuantity::RECENT), 1);
+
+    // Time blocked per wait point
+    for (int waitPoint = 0; waitPoint < ThreadMonitorCollection::WAIT_POINTS; ++waitPoint)
+    {
+      tableDiv = maker.addNode("td", tableRow, tableValueAttr_);
+      maker.addDouble(tableDiv,
+        100 * stats.waitTimeStats[waitPoint].getValueRate(stor::MonitoredQuantity::RECENT), 1);
+    }
+  }
+  
+  
   void SMPSWebPageHelper::addRowForEventServer
   (
     stor::XHTMLMaker& maker,
@@ -699,6 +1135,14 @@ namespace smproxy
     tableDiv = maker.addNode("td", tableRow, tableValueAttr_);
     maker.addDouble(tableDiv,
       stats.eventStats.corruptedEventsStats.getValueRate(stor::MonitoredQuantity::RECENT));
+    
+    // Discarded event rate
+    tableDiv = maker.addNode("td", tableRow, tableValueAttr_);
+    maker.addDouble(tableDiv,
+      stats.eventStats.discardedEventsStats.getSampleRate(stor::MonitoredQuantity::FULL));
+    tableDiv = maker.addNode("td", tableRow, tableValueAttr_);
+    maker.addDouble(tableDiv,
+      stats.eventStats.discardedEventsStats.getSampleRate(stor::MonitoredQuantity::RECENT));
   }
   
   
@@ -752,6 +1196,14 @@ namespace smproxy
     tableDiv = maker.addNode("td", tableRow, tableValueAttr_);
     maker.addDouble(tableDiv,
       pos->second.corruptedEventsStats.getValueRate(stor::MonitoredQuantity::RECENT));
+    
+    // Discarded event rate
+    tableDiv = maker.addNode("td", tableRow, tableValueAttr_);
+    maker.addDouble(tableDiv,
+      pos->second.discardedEventsStats.getSampleRate(stor::MonitoredQuantity::FULL));
+    tableDiv = maker.addNode("td", tableRow, tableValueAttr_);
+    maker.addDouble(tableDiv,
+      pos->second.discardedEventsStats.getSampleRate(stor::MonitoredQuantity::RECENT));
   }
   
   
@@ -81,6 +81,7 @@ void SMProxyServer::bindWebInterfaceCallbacks()
   xgi::bind(this,&SMProxyServer::dataRetrieverWebPage,     "dataRetriever");
   xgi::bind(this,&SMProxyServer::dqmEventStatisticsWebPage,"dqmEventStatistics");
   xgi::bind(this,&SMProxyServer::consumerStatisticsWebPage,"consumerStatistics" );
+  xgi::bind(this,&SMProxyServer::threadStatisticsWebPage,  "threadStatistics");
 }
 
 
@@ -262,6 +263,33 @@ throw (xgi::exception::Exception)
 }
 
 
+void SMProxyServer::threadStatisticsWebPage(xgi::Input *in, xgi::Output *out)
+throw (xgi::exception::Exception)
+{
+  std::string errorMsg = "Failed to create the thread statistics webpage";
+
+  try
+  {
+    smpsWebPageHelper_->threadStatisticsWebPage(out);
+  }
+  catch(std::exception &e)
+  {
+    errorMsg += ": ";
+    errorMsg += e.what();
+    
+    LOG4CPLUS_ERROR(getApplicationLogger(), errorMsg);
+    XCEPT_RAISE(xgi::exception::Exception, errorMsg);
+  }
+  catch(...)
+  {
+    errorMsg += ": Unknown exception";
+    
+    LOG4CPLUS_ERROR(getApplicationLogger(), errorMsg);
+    XCEPT_RAISE(xgi::exception::Exception, errorMsg);
+  }
+}
+
+
 ///////////////////////////////////////
 // State Machine call back functions //
 ///////////////////////////////////////
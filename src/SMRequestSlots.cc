@@ -0,0 +1,91 @@
+// $Id$
+/// @file: SMRequestSlots.cc
+
+#include "EventFilter/SMProxyServer/interface/SMRequestSlots.h"
+#include "EventFilter/SMProxyServer/interface/ThreadMonitorCollection.h"
+
+
+namespace smproxy
+{
+  SMRequestSlots::SMRequestSlots() :
+  limit_(0)
+  {}
+
+
+  void SMRequestSlots::setLimit(const unsigned int maxRequestsPerHost)
+  {
+    boost::mutex::scoped_lock sl(mutex_);
+    limit_ = maxRequestsPerHost;
+    released_.notify_all();
+  }
+
+
+  void SMRequestSlots::acquire(const std::string& sourceURL)
+  {
+    const std::string host = getHost(sourceURL);
+
+    boost::mutex::scoped_lock sl(mutex_);
+    unsigned int& outstanding = outstanding_[host];
+    if ( limit_ > 0 && outstanding >= limit_ )
+    {
+      ThreadMonitorCollection::WaitTimer waitTimer(ThreadMonitorCollection::THROTTLE_WAIT);
+      while ( limit_ > 0 && outstanding >= limit_ )
+        released_.wait(sl);
+    }
+    ++outstanding;
+  }
+
+
+  void SMRequestSlots::release(const std::string& sourceURL)
+  {
+    const std::string host = getHost(sourceURL);
+
+    boost::mutex::scoped_lock sl(mutex_);
+    RequestCounts::iterator pos = outstanding_.find(host);
+    if ( pos == outstanding_.end() || pos->second == 0 ) return;
+    --(pos->second);
+    released_.notify_all();
+  }
+
+
+  void SMRequestSlots::getOutstandingRequests(RequestCounts& counts) const
+  {
+    boost::mutex::scoped_lock sl(mutex_);
+    counts = outstanding_;
+  }
+
+
+  std::string SMRequestSlots::getHost(const std::string& sourceURL)
+  {
+    std::string::size_type startPos = sourceURL.find("//");
+    if ( startPos == std::string::npos )
+      startPos = 0;
+    else
+      startPos += 2;
+    const std::string::size_type endPos = sourceURL.find_first_of(":/", startPos);
+    return sourceURL.substr(startPos, endPos - startPos);
+  }
+
+
+  SMRequestSlots::Slot::Slot(SMRequestSlots& slots, const std::string& sourceURL) :
+  slots_(slots),
+  sourceURL_(sourceURL)
+  {
+    slots_.acquire(sourceURL_);
+  }
+
+
+  SMRequestSlots::Slot::~Slot()
+  {
+    slots_.release(sourceURL_);
+  }
+
+} // namespace smproxy
+
+
+/// emacs configuration
+/// Local Variables: -
+/// mode: c++ -
+/// c-basic-offset: 2 -
+/// indent-tabs-mode: nil -
+/// End: -
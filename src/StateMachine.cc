@@ -4,6 +4,7 @@
 #include "EventFilter/SMProxyServer/interface/DataManager.h"
 #include "EventFilter/SMProxyServer/interface/StateMachine.h"
 #include "EventFilter/SMProxyServer/interface/States.h"
+#include "EventFilter/SMProxyServer/interface/ThreadAffinity.h"
 #include "EventFilter/StorageManager/interface/EventConsumerMonitorCollection.h"
 #include "EventFilter/StorageManager/interface/DQMConsumerMonitorCollection.h"
 
@@ -68,6 +69,9 @@ namespace smproxy
     dqmEventQueueCollection_.reset(new stor::DQMEventQueueCollection(
         statisticsReporter_->getDQMConsumerMonitorCollection()));
     
+    bandwidthLimiter_.reset(new BandwidthLimiter());
+    smRequestSlots_.reset(new SMRequestSlots());
+
     dataManager_.reset(new DataManager(this));
   }
   
@@ -147,8 +151,8 @@ namespace smproxy
   
   void StateMachine::setQueueSizes()
   {
-    QueueConfigurationParams queueParams =
-      configuration_->getQueueConfigurationParams();
+    const ConfigurationSnapshotPtr configuration = configuration_->getSnapshot();
+    const QueueConfigurationParams& queueParams = configuration->queueConfigParams_;
     registrationQueue_->
       setCapacity(queueParams.registrationQueueSize_);
   }
@@ -156,13 +160,57 @@ namespace smproxy
   
   void StateMachine::setAlarms()
   {
-    AlarmParams alarmParams =
-      configuration_->getAlarmParams();
+    const ConfigurationSnapshotPtr configuration = configuration_->getSnapshot();
+    const AlarmParams& alarmParams = configuration->alarmParams_;
     statisticsReporter_->getDataRetrieverMonitorCollection().
       configureAlarms(alarmParams);
   }
   
   
+  void StateMachine::setThreadAffinity()
+  {
+    const ConfigurationSnapshotPtr configuration = configuration_->getSnapshot();
+    const ThreadAffinityParams& threadAffinityParams = configuration->threadAffinityParams_;
+
+    try
+    {
+      ThreadAffinity::validate(threadAffinityParams.retrieverCPUs_);
+      ThreadAffinity::validate(threadAffinityParams.dataManagerCPUs_);
+      ThreadAffinity::validate(threadAffinityParams.archiverCPUs_);
+      ThreadAffinity::validate(threadAffinityParams.monitoringCPUs_);
+    }
+    catch(xcept::Exception &e)
+    {
+      XCEPT_DECLARE_NESTED(exception::Configuration,
+        sentinelException, "Invalid thread affinity", e);
+      moveToFailedState(sentinelException);
+      return;
+    }
+
+    // The threads started later pick up their CPUs when they start
+    dataManager_->setWatchDogCPUs(threadAffinityParams.dataManagerCPUs_);
+    statisticsReporter_->setMonitoringCPUs(threadAffinityParams.monitoringCPUs_);
+  }
+  
+  
+  void StateMachine::setUpstreamLimits()
+  {
+    const ConfigurationSnapshotPtr configuration = configuration_->getSnapshot();
+    const DataRetrieverParams& dataRetrieverParams = configuration->dataRetrieverParams_;
+    bandwidthLimiter_->setLimits(
+      dataRetrieverParams.maxBandwidth_ * 1024 * 1024,
+      dataRetrieverParams.maxBandwidthPerSM_ * 1024 * 1024
+    );
+    smRequestSlots_->setLimit(dataRetrieverParams.maxRequestsPerSM_);
+  }
+  
+  
+  void StateMachine::prewarmConnections()
+  {
+    dataManager_->prewarm(configuration_->getSnapshot());
+  }
+  
+  
   void StateMachine::clearInitMsgCollection()
   {
     initMsgCollection_->clear();
@@ -171,12 +219,18 @@ namespace smproxy
   
   void StateMachine::resetStatistics()
   {
+    // The connections of the retrievers kept from the last run stay valid
+    statisticsReporter_->getDataRetrieverMonitorCollection().
+      keepConnectionsOnReset( dataManager_->isPaused() );
     statisticsReporter_->reset();
   }
   
   
   void StateMachine::clearConsumerRegistrations()
   {
+    // The consumers of the retrievers kept from the last run stay registered
+    if ( dataManager_->isPaused() ) return;
+
     registrationCollection_->clearRegistrations();
     eventQueueCollection_->removeQueues();
     dqmEventQueueCollection_->removeQueues();
@@ -186,7 +240,7 @@ namespace smproxy
   void StateMachine::enableConsumerRegistration()
   {
     registrationCollection_->enableConsumerRegistration();
-    dataManager_->start(configuration_->getDataRetrieverParams());
+    dataManager_->start(configuration_->getSnapshot());
   }
  
   
@@ -197,6 +251,16 @@ namespace smproxy
   }
  
   
+  void StateMachine::suspendConsumerRegistration()
+  {
+    registrationCollection_->disableConsumerRegistration();
+    if ( configuration_->getSnapshot()->dataRetrieverParams_.warmRestart_ )
+      dataManager_->pause();
+    else
+      dataManager_->stop();
+  }
+ 
+  
   void StateMachine::clearQueues()
   {
     registrationQueue_->clear();
@@ -222,6 +286,12 @@ namespace smproxy
     boost::this_thread::interruption_point();
     stateMachine.setAlarms();
     boost::this_thread::interruption_point();
+    stateMachine.setThreadAffinity();
+    boost::this_thread::interruption_point();
+    stateMachine.setUpstreamLimits();
+    boost::this_thread::interruption_point();
+    stateMachine.prewarmConnections();
+    boost::this_thread::interruption_point();
     stateMachine.processEvent( ConfiguringDone() );
   }
 
@@ -272,7 +342,7 @@ namespace smproxy
   void Stopping::activity()
   {
     outermost_context_type& stateMachine = outermost_context();
-    stateMachine.disableConsumerRegistration();
+    stateMachine.suspendConsumerRegistration();
     boost::this_thread::interruption_point();
     stateMachine.clearQueues();
     boost::this_thread::interruption_point();
@@ -31,7 +31,9 @@ namespace smproxy {
   dqmEventMonCollection_(monitoringSleepSec_*5),
   eventConsumerMonCollection_(monitoringSleepSec_),
   dqmConsumerMonCollection_(monitoringSleepSec_),
-  doMonitoring_(monitoringSleepSec_>boost::posix_time::seconds(0))
+  threadMonCollection_(monitoringSleepSec_),
+  doMonitoring_(monitoringSleepSec_>boost::posix_time::seconds(0)),
+  monitorThreadRegistered_(false)
   {
     reset();
     createMonitoringInfoSpace();
@@ -124,6 +126,7 @@ namespace smproxy {
     dqmEventMonCollection_.appendInfoSpaceItems(infoSpaceItems);
     eventConsumerMonCollection_.appendInfoSpaceItems(infoSpaceItems);
     dqmConsumerMonCollection_.appendInfoSpaceItems(infoSpaceItems);
+    threadMonCollection_.appendInfoSpaceItems(infoSpaceItems);
     
     putItemsIntoInfoSpace(infoSpaceItems);
   }
@@ -168,8 +171,16 @@ namespace smproxy {
     
     std::string errorMsg = "Failed to update the monitoring information";
     
+    // The workloop thread lives as long as the application
+    if ( ! monitorThreadRegistered_ )
+    {
+      threadMonCollection_.registerThread("StatisticsReporter");
+      monitorThreadRegistered_ = true;
+    }
+
     try
     {
+      monitorAffinity_.apply();
       calculateStatistics();
       updateInfoSpace();
     }
@@ -218,6 +229,7 @@ namespace smproxy {
     dqmEventMonCollection_.calculateStatistics(now);
     eventConsumerMonCollection_.calculateStatistics(now);
     dqmConsumerMonCollection_.calculateStatistics(now);
+    threadMonCollection_.calculateStatistics(now);
   }
   
   
@@ -235,6 +247,7 @@ namespace smproxy {
       dqmEventMonCollection_.updateInfoSpaceItems();
       eventConsumerMonCollection_.updateInfoSpaceItems();
       dqmConsumerMonCollection_.updateInfoSpaceItems();
+      threadMonCollection_.updateInfoSpaceItems();
       
       infoSpace_->unlock();
     }
@@ -274,6 +287,7 @@ namespace smproxy {
     dqmEventMonCollection_.reset(now);
     eventConsumerMonCollection_.reset(now);
     dqmConsumerMonCollection_.reset(now);
+    threadMonCollection_.reset(now);
     
     alarmHandler_->clearAllAlarms();
   }
@@ -0,0 +1,173 @@
+// $Id$
+/// @file: ThreadAffinity.cc
+
+#include "EventFilter/SMProxyServer/interface/Exception.h"
+#include "EventFilter/SMProxyServer/interface/ThreadAffinity.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <sstream>
+#include <vector>
+
+
+namespace
+{
+  typedef std::vector<std::string> Strings;
+
+  Strings split(const std::string& str, const char separator)
+  {
+    Strings tokens;
+    std::string::size_type begin = 0;
+    std::string::size_type end;
+    while ( (end = str.find(separator, begin)) != std::string::npos )
+    {
+      tokens.push_back(str.substr(begin, end - begin));
+      begin = end + 1;
+    }
+    tokens.push_back(str.substr(begin));
+    return tokens;
+  }
+
+  bool parseCPU(const std::string& str, long& cpu)
+  {
+    if ( str.empty() || str.find_first_not_of("0123456789") != std::string::npos )
+      return false;
+    cpu = strtol(str.c_str(), 0, 10);
+    return ( cpu < CPU_SETSIZE );
+  }
+
+  bool parseCPUList(const std::string& cpuList, cpu_set_t& cpus)
+  {
+    CPU_ZERO(&cpus);
+
+    const Strings ranges = split(cpuList, ',');
+    for (Strings::const_iterator it = ranges.begin(), itEnd = ranges.end();
+         it != itEnd; ++it)
+    {
+      const std::string::size_type dash = it->find('-');
+      long first, last;
+      if ( dash == std::string::npos )
+      {
+        if ( ! parseCPU(*it, first) ) return false;
+        last = first;
+      }
+      else if ( ! parseCPU(it->substr(0, dash), first) ||
+        ! parseCPU(it->substr(dash + 1), last) || last < first )
+      {
+        return false;
+      }
+
+      for (long cpu = first; cpu <= last; ++cpu)
+        CPU_SET(cpu, &cpus);
+    }
+    return true;
+  }
+
+  void getCPUs(const std::string& cpuLists, const size_t instance, cpu_set_t& cpus)
+  {
+    if ( cpuLists.empty() )
+    {
+      CPU_ZERO(&cpus);
+      const long cpuCount = sysconf(_SC_NPROCESSORS_CONF);
+      for (long cpu = 0; cpu < cpuCount && cpu < CPU_SETSIZE; ++cpu)
+        CPU_SET(cpu, &cpus);
+      return;
+    }
+
+    const Strings lists = split(cpuLists, ';');
+    if ( ! parseCPUList(lists[instance % lists.size()], cpus) )
+    {
+      std::ostringstream msg;
+      msg << "Malformed CPU list '" << cpuLists << "'";
+      XCEPT_RAISE(smproxy::exception::Configuration, msg.str());
+    }
+  }
+}
+
+
+namespace smproxy
+{
+  ThreadAffinity::ThreadAffinity() :
+  instance_(0),
+  changed_(false)
+  {}
+
+
+  void ThreadAffinity::setCPUs(const std::string& cpuLists, const size_t instance)
+  {
+    boost::mutex::scoped_lock sl(mutex_);
+    if ( cpuLists == cpuLists_ && instance == instance_ ) return;
+    cpuLists_ = cpuLists;
+    instance_ = instance;
+    changed_ = true;
+  }
+
+
+  void ThreadAffinity::apply()
+  {
+    std::string cpuLists;
+    size_t instance;
+    {
+      boost::mutex::scoped_lock sl(mutex_);
+      if ( ! changed_ ) return;
+      cpuLists = cpuLists_;
+      instance = instance_;
+      changed_ = false;
+    }
+    pinCurrentThread(cpuLists, instance);
+  }
+
+
+  void ThreadAffinity::validate(const std::string& cpuLists)
+  {
+    if ( cpuLists.empty() ) return;
+
+    cpu_set_t allowed;
+    if ( sched_getaffinity(0, sizeof(allowed), &allowed) != 0 )
+      CPU_ZERO(&allowed);
+
+    const Strings lists = split(cpuLists, ';');
+    for (size_t instance = 0; instance < lists.size(); ++instance)
+    {
+      cpu_set_t cpus;
+      getCPUs(cpuLists, instance, cpus);
+
+      // pinning fails if none of the CPUs may be used by the process
+      CPU_AND(&cpus, &cpus, &allowed);
+      if ( CPU_COUNT(&cpus) == 0 )
+      {
+        std::ostringstream msg;
+        msg << "None of the CPUs in '" << lists[instance] << "' is available";
+        XCEPT_RAISE(exception::Configuration, msg.str());
+      }
+    }
+  }
+
+
+  void ThreadAffinity::pinCurrentThread(const std::string& cpuLists, const size_t instance)
+  {
+    cpu_set_t cpus;
+    getCPUs(cpuLists, instance, cpus);
+
+    const int err = pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+    if ( err != 0 )
+    {
+      std::ostringstream msg;
+      msg << "Failed to pin thread to CPU list '" << cpuLists << "': " << strerror(err);
+      XCEPT_RAISE(exception::Configuration, msg.str());
+    }
+  }
+
+} // namespace smproxy
+
+
+/// emacs configuration
+/// Local Variables: -
+/// mode: c++ -
+/// c-basic-offset: 2 -
+/// indent-tabs-mode: nil -
+/// End: -
@@ -0,0 +1,341 @@
+// $Id$
+/// @file: ThreadMonitorCollection.cc
+
+#include "EventFilter/SMProxyServer/interface/ThreadMonitorCollection.h"
+
+#include <fstream>
+#include <sstream>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+
+namespace
+{
+  pid_t threadId()
+  {
+    return static_cast<pid_t>( syscall(SYS_gettid) );
+  }
+
+  std::string taskFile(const pid_t tid, const std::string& file)
+  {
+    std::ostringstream fileName;
+    fileName << "/proc/self/task/" << tid << "/" << file;
+    return fileName.str();
+  }
+
+  // Return the user and system CPU time of the given thread in seconds
+  bool readCPUTime(const pid_t tid, double& cpuTime)
+  {
+    std::ifstream stat(taskFile(tid, "stat").c_str());
+    std::string line;
+    if ( ! std::getline(stat, line) ) return false;
+
+    // The command name in parentheses may contain blanks
+    const std::string::size_type pos = line.rfind(')');
+    if ( pos == std::string::npos ) return false;
+
+    // utime and stime are the 12th and 13th fields after the command name
+    std::istringstream fields(line.substr(pos + 1));
+    std::string field;
+    for (int i = 0; i < 11; ++i) fields >> field;
+    unsigned long utime, stime;
+    if ( ! (fields >> utime >> stime) ) return false;
+
+    cpuTime = static_cast<double>(utime + stime) / sysconf(_SC_CLK_TCK);
+    return true;
+  }
+
+  bool readContextSwitches(const pid_t tid, long& voluntary, long& involuntary)
+  {
+    std::ifstream status(taskFile(tid, "status").c_str());
+    std::string key;
+    int found = 0;
+    while ( status >> key )
+    {
+      if ( key == "voluntary_ctxt_switches:" && status >> voluntary ) ++found;
+      else if ( key == "nonvoluntary_ctxt_switches:" && status >> involuntary ) ++found;
+    }
+    return ( found == 2 );
+  }
+}
+
+
+namespace smproxy {
+
+  boost::thread_specific_ptr<ThreadMonitorCollection::ThreadMQPtr>
+  ThreadMonitorCollection::currentThread_;
+
+
+  ThreadMonitorCollection::ThreadMonitorCollection
+  (
+    const stor::utils::Duration_t& updateInterval
+  ) :
+  MonitorCollection(updateInterval),
+  updateInterval_(updateInterval),
+  threadWaitTimes_(WAIT_POINTS)
+  {}
+
+
+  void ThreadMonitorCollection::registerThread(const std::string& name)
+  {
+    const pid_t tid = threadId();
+    ThreadMQPtr threadMQ( new ThreadMQ(name, tid, updateInterval_) );
+
+    currentThread_.reset( new ThreadMQPtr(threadMQ) );
+
+    boost::mutex::scoped_lock sl(threadsMutex_);
+    threadMqMap_[tid] = threadMQ;
+  }
+
+
+  void ThreadMonitorCollection::unregisterThread()
+  {
+    currentThread_.reset();
+
+    boost::mutex::scoped_lock sl(threadsMutex_);
+    threadMqMap_.erase(threadId());
+  }
+
+
+  void ThreadMonitorCollection::addWaitTime
+  (
+    const WaitPoint& waitPoint,
+    const double& seconds
+  )
+  {
+    ThreadMQPtr* threadMQ = currentThread_.get();
+    if ( ! threadMQ ) return;
+
+    (*threadMQ)->waitTime_[waitPoint]->addSample(seconds);
+  }
+
+
+  void ThreadMonitorCollection::getStats(ThreadStatList& stats) const
+  {
+    stats.clear();
+
+    boost::mutex::scoped_lock sl(threadsMutex_);
+    stats.reserve(threadMqMap_.size());
+
+    for (ThreadMqMap::const_iterator it = threadMqMap_.begin(), itEnd = threadMqMap_.end();
+         it != itEnd; ++it)
+    {
+      ThreadStats threadStats;
+      it->second->getStats(threadStats);
+      stats.push_back(threadStats);
+    }
+  }
+
+
+  std::string ThreadMonitorCollection::waitPointName(const WaitPoint& waitPoint)
+  {
+    switch (waitPoint)
+    {
+      case SM_REQUEST_WAIT:
+        return "SM request";
+      case THROTTLE_WAIT:
+        return "Throttling";
+      case STATS_LOCK_WAIT:
+        return "Statistics lock";
+      case QUEUE_WAIT:
+        return "Queues";
+      default:
+        return "Unknown";
+    }
+  }
+
+
+  void ThreadMonitorCollection::do_calculateStatistics()
+  {
+    // Reading /proc is slow. Do not block registering threads meanwhile.
+    std::vector<ThreadMQPtr> threadMQs;
+    {
+      boost::mutex::scoped_lock sl(threadsMutex_);
+      threadMQs.reserve(threadMqMap_.size());
+      for (ThreadMqMap::const_iterator it = threadMqMap_.begin(), itEnd = threadMqMap_.end();
+           it != itEnd; ++it)
+        threadMQs.push_back(it->second);
+    }
+
+    for (std::vector<ThreadMQPtr>::const_iterator it = threadMQs.begin(), itEnd = threadMQs.end();
+         it != itEnd; ++it)
+    {
+      (*it)->sample();
+      (*it)->calculateStatistics();
+    }
+  }
+
+
+  void ThreadMonitorCollection::do_reset()
+  {
+    boost::mutex::scoped_lock sl(threadsMutex_);
+
+    for (ThreadMqMap::const_iterator it = threadMqMap_.begin(), itEnd = threadMqMap_.end();
+         it != itEnd; ++it)
+      it->second->reset();
+  }
+
+
+  void ThreadMonitorCollection::do_appendInfoSpaceItems(InfoSpaceItems& infoSpaceItems)
+  {
+    infoSpaceItems.push_back(std::make_pair("threadNames", &threadNames_));
+    infoSpaceItems.push_back(std::make_pair("threadCPUUsage", &threadCPUUsage_));
+    infoSpaceItems.push_back(std::make_pair("threadVoluntaryContextSwitches", &threadVoluntarySwitches_));
+    infoSpaceItems.push_back(std::make_pair("threadInvoluntaryContextSwitches", &threadInvoluntarySwitches_));
+    infoSpaceItems.push_back(std::make_pair("threadSMRequestWait", &threadWaitTimes_[SM_REQUEST_WAIT]));
+    infoSpaceItems.push_back(std::make_pair("threadThrottleWait", &threadWaitTimes_[THROTTLE_WAIT]));
+    infoSpaceItems.push_back(std::make_pair("threadStatsLockWait", &threadWaitTimes_[STATS_LOCK_WAIT]));
+    infoSpaceItems.push_back(std::make_pair("threadQueueWait", &threadWaitTimes_[QUEUE_WAIT]));
+  }
+
+
+  void ThreadMonitorCollection::do_updateInfoSpaceItems()
+  {
+    ThreadStatList stats;
+    getStats(stats);
+
+    threadNames_.clear();
+    threadCPUUsage_.clear();
+    threadVoluntarySwitches_.clear();
+    threadInvoluntarySwitches_.clear();
+    for (int waitPoint = 0; waitPoint < WAIT_POINTS; ++waitPoint)
+      threadWaitTimes_[waitPoint].clear();
+
+    for (ThreadStatList::const_iterator it = stats.begin(), itEnd = stats.end();
+         it != itEnd; ++it)
+    {
+      threadNames_.push_back(it->name);
+      threadCPUUsage_.push_back(
+        it->cpuTimeStats.getValueRate(stor::MonitoredQuantity::RECENT));
+      threadVoluntarySwitches_.push_back(
+        it->voluntarySwitchStats.getValueRate(stor::MonitoredQuantity::RECENT));
+      threadInvoluntarySwitches_.push_back(
+        it->involuntarySwitchStats.getValueRate(stor::MonitoredQuantity::RECENT));
+      for (int waitPoint = 0; waitPoint < WAIT_POINTS; ++waitPoint)
+      {
+        threadWaitTimes_[waitPoint].push_back(
+          it->waitTimeStats[waitPoint].getValueRate(stor::MonitoredQuantity::RECENT));
+      }
+    }
+  }
+
+
+  ThreadMonitorCollection::ThreadMQ::ThreadMQ
+  (
+    const std::string& name,
+    const pid_t threadId,
+    const stor::utils::Duration_t& updateInterval
+  ) :
+  name_(name),
+  threadId_(threadId),
+  lastCPUTime_(0),
+  lastVoluntarySwitches_(0),
+  lastInvoluntarySwitches_(0),
+  cpuTime_(updateInterval, boost::posix_time::seconds(60)),
+  voluntarySwitches_(updateInterval, boost::posix_time::seconds(60)),
+  involuntarySwitches_(updateInterval, boost::posix_time::seconds(60))
+  {
+    for (int waitPoint = 0; waitPoint < WAIT_POINTS; ++waitPoint)
+    {
+      waitTime_.push_back(
+        MQPtr(new stor::MonitoredQuantity(updateInterval, boost::posix_time::seconds(60)))
+      );
+    }
+
+    // Only count the usage from now on
+    readCPUTime(threadId_, lastCPUTime_);
+    readContextSwitches(threadId_, lastVoluntarySwitches_, lastInvoluntarySwitches_);
+  }
+
+
+  void ThreadMonitorCollection::ThreadMQ::sample()
+  {
+    double cpuTime;
+    if ( readCPUTime(threadId_, cpuTime) )
+    {
+      cpuTime_.addSample(cpuTime - lastCPUTime_);
+      lastCPUTime_ = cpuTime;
+    }
+
+    long voluntary, involuntary;
+    if ( readContextSwitches(threadId_, voluntary, involuntary) )
+    {
+      voluntarySwitches_.addSample(voluntary - lastVoluntarySwitches_);
+      involuntarySwitches_.addSample(involuntary - lastInvoluntarySwitches_);
+      lastVoluntarySwitches_ = voluntary;
+      lastInvoluntarySwitches_ = involuntary;
+    }
+  }
+
+
+  void ThreadMonitorCollection::ThreadMQ::getStats(ThreadStats& stats) const
+  {
+    stats.name = name_;
+    cpuTime_.getStats(stats.cpuTimeStats);
+    voluntarySwitches_.getStats(stats.voluntarySwitchStats);
+    involuntarySwitches_.getStats(stats.involuntarySwitchStats);
+
+    stats.waitTimeStats.resize(WAIT_POINTS);
+    for (int waitPoint = 0; waitPoint < WAIT_POINTS; ++waitPoint)
+      waitTime_[waitPoint]->getStats(stats.waitTimeStats[waitPoint]);
+  }
+
+
+  void ThreadMonitorCollection::ThreadMQ::calculateStatistics()
+  {
+    cpuTime_.calculateStatistics();
+    voluntarySwitches_.calculateStatistics();
+    involuntarySwitches_.calculateStatistics();
+    for (int waitPoint = 0; waitPoint < WAIT_POINTS; ++waitPoint)
+      waitTime_[waitPoint]->calculateStatistics();
+  }
+
+
+  void ThreadMonitorCollection::ThreadMQ::reset()
+  {
+    cpuTime_.reset();
+    voluntarySwitches_.reset();
+    involuntarySwitches_.reset();
+    for (int waitPoint = 0; waitPoint < WAIT_POINTS; ++waitPoint)
+      waitTime_[waitPoint]->reset();
+  }
+
+
+  ThreadMonitorCollection::Registration::Registration
+  (
+    ThreadMonitorCollection& threadMonitorCollection,
+    const std::string& name
+  ) :
+  threadMonitorCollection_(threadMonitorCollection)
+  {
+    threadMonitorCollection_.registerThread(name);
+  }
+
+
+  ThreadMonitorCollection::Registration::~Registration()
+  {
+    threadMonitorCollection_.unregisterThread();
+  }
+
+
+  ThreadMonitorCollection::WaitTimer::WaitTimer(const WaitPoint& waitPoint) :
+  waitPoint_(waitPoint),
+  startTime_(stor::utils::getCurrentTime())
+  {}
+
+
+  ThreadMonitorCollection::WaitTimer::~WaitTimer()
+  {
+    addWaitTime(waitPoint_,
+      stor::utils::durationToSeconds(stor::utils::getCurrentTime() - startTime_));
+  }
+
+} // namespace smproxy
+
+
+/// emacs configuration
+/// Local Variables: -
+/// mode: c++ -
+/// c-basic-offset: 2 -
+/// indent-tabs-mode: nil -
+/// End: -
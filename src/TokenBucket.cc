@@ -0,0 +1,113 @@
+// $Id$
+/// @file: TokenBucket.cc
+
+#include "EventFilter/SMProxyServer/interface/TokenBucket.h"
+
+#include <algorithm>
+
+
+namespace smproxy
+{
+  TokenBucket::TokenBucket
+  (
+    const stor::utils::Duration_t& interval,
+    const double depth
+  ) :
+  rate_(0),
+  depth_(depth),
+  tokens_(depth),
+  lastRefill_(stor::utils::getCurrentTime())
+  {
+    if ( ! interval.is_not_a_date_time() && interval > boost::posix_time::seconds(0) )
+      rate_ = 1 / stor::utils::durationToSeconds(interval);
+  }
+  
+  
+  TokenBucket::TokenBucket
+  (
+    const double tokensPerSecond,
+    const double depth
+  ) :
+  rate_(std::max(tokensPerSecond, 0.)),
+  depth_(depth),
+  tokens_(depth),
+  lastRefill_(stor::utils::getCurrentTime())
+  {}
+  
+  
+  bool TokenBucket::hasTokens
+  (
+    const stor::utils::TimePoint_t& now,
+    const double tokens
+  )
+  {
+    if ( unlimited() ) return true;
+    
+    refill(now);
+    return ( tokens_ >= tokens );
+  }
+  
+  
+  bool TokenBucket::tryConsume
+  (
+    const stor::utils::TimePoint_t& now,
+    const double tokens
+  )
+  {
+    if ( ! hasTokens(now, tokens) ) return false;
+    
+    if ( ! unlimited() ) tokens_ -= tokens;
+    return true;
+  }
+  
+  
+  void TokenBucket::consume
+  (
+    const stor::utils::TimePoint_t& now,
+    const double tokens
+  )
+  {
+    if ( unlimited() ) return;
+    
+    refill(now);
+    tokens_ -= tokens;
+  }
+  
+  
+  stor::utils::TimePoint_t TokenBucket::nextAvailable
+  (
+    const stor::utils::TimePoint_t& now,
+    const double tokens
+  )
+  {
+    if ( hasTokens(now, tokens) ) return now;
+    
+    return now + stor::utils::secondsToDuration( (tokens - tokens_) / rate_ );
+  }
+  
+  
+  void TokenBucket::setRate(const double tokensPerSecond)
+  {
+    refill(stor::utils::getCurrentTime());
+    rate_ = std::max(tokensPerSecond, 0.);
+  }
+  
+  
+  void TokenBucket::refill(const stor::utils::TimePoint_t& now)
+  {
+    if ( now > lastRefill_ )
+    {
+      tokens_ = std::min(depth_,
+        tokens_ + rate_ * stor::utils::durationToSeconds(now - lastRefill_));
+      lastRefill_ = now;
+    }
+  }
+
+} // namespace smproxy
+  
+/// emacs configuration
+/// Local Variables: -
+/// mode: c++ -
+/// c-basic-offset: 2 -
+/// indent-tabs-mode: nil -
+/// End: -
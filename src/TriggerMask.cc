@@ -0,0 +1,274 @@
+// $Id$
+/// @file: TriggerMask.cc
+
+#include "EventFilter/SMProxyServer/interface/TriggerMask.h"
+
+#include <algorithm>
+#include <sstream>
+
+
+namespace
+{
+  // Each byte of the HLT trigger bits holds the 2-bit status of 4 paths.
+  // The table maps each byte value to a nibble of the paths which passed.
+  struct AcceptedPathsTable
+  {
+    uint64_t nibble[256];
+
+    AcceptedPathsTable()
+    {
+      for (unsigned int byte = 0; byte < 256; ++byte)
+      {
+        nibble[byte] = 0;
+        for (unsigned int path = 0; path < 4; ++path)
+        {
+          if ( ((byte >> (path*2)) & 0x03) == 1 ) // hlt::Pass
+            nibble[byte] |= (1 << path);
+        }
+      }
+    }
+  };
+
+  const AcceptedPathsTable acceptedPathsTable;
+}
+
+
+namespace smproxy
+{
+  TriggerMask::TriggerMask() :
+  acceptAll_(true)
+  {}
+  
+  
+  bool TriggerMask::isSimple
+  (
+    const std::string& triggerSelection,
+    const Strings& eventSelection
+  )
+  {
+    Strings patterns;
+    return getPathPatterns(triggerSelection, eventSelection, patterns);
+  }
+  
+  
+  void TriggerMask::compile
+  (
+    const std::string& triggerSelection,
+    const Strings& eventSelection,
+    const Strings& hltTriggerNames
+  )
+  {
+    mask_.clear();
+    acceptAll_ = true;
+
+    Strings patterns;
+    if ( ! getPathPatterns(triggerSelection, eventSelection, patterns) ) return;
+    if ( patterns.empty() ) return;
+
+    mask_.resize( (hltTriggerNames.size() + 63) / 64, 0 );
+
+    for ( Strings::const_iterator pattern = patterns.begin(), patternEnd = patterns.end();
+          pattern != patternEnd; ++pattern )
+    {
+      if ( *pattern == "*" ) return;
+
+      for (size_t i = 0; i < hltTriggerNames.size(); ++i)
+      {
+        if ( matches(pattern->c_str(), hltTriggerNames[i].c_str()) )
+          mask_[i/64] |= (uint64_t(1) << (i%64));
+      }
+    }
+
+    acceptAll_ = false;
+  }
+  
+  
+  void TriggerMask::getAcceptedPaths
+  (
+    const EventMsgView& view,
+    Words& acceptedPaths
+  )
+  {
+    const uint32 hltCount = view.hltCount();
+    const size_t byteCount = (hltCount + 3) / 4;
+
+    acceptedPaths.assign( (hltCount + 63) / 64, 0 );
+    if ( byteCount == 0 ) return;
+
+    std::vector<unsigned char> hltBits(byteCount);
+    view.hltTriggerBits(&hltBits[0]);
+
+    for (size_t byte = 0; byte < byteCount; ++byte)
+    {
+      acceptedPaths[byte/16] |=
+        acceptedPathsTable.nibble[hltBits[byte]] << ((byte%16)*4);
+    }
+  }
+  
+  
+  bool TriggerMask::accepts(const Words& acceptedPaths) const
+  {
+    if ( acceptAll_ ) return true;
+
+    const size_t wordCount = std::min(mask_.size(), acceptedPaths.size());
+    for (size_t i = 0; i < wordCount; ++i)
+    {
+      if ( mask_[i] & acceptedPaths[i] ) return true;
+    }
+
+    return false;
+  }
+  
+  
+  TriggerMaskSet::TriggerMaskSet() :
+  consumerCount_(0)
+  {}
+  
+  
+  void TriggerMaskSet::clear()
+  {
+    consumerCount_ = 0;
+    acceptAll_.clear();
+    consumersByPath_.clear();
+  }
+  
+  
+  void TriggerMaskSet::add(const TriggerMask& triggerMask)
+  {
+    const size_t consumer = consumerCount_++;
+    const size_t wordCount = (consumerCount_ + 63) / 64;
+    const uint64_t consumerBit = uint64_t(1) << (consumer%64);
+
+    acceptAll_.resize(wordCount, 0);
+    for ( std::vector<Words>::iterator it = consumersByPath_.begin(),
+            itEnd = consumersByPath_.end(); it != itEnd; ++it )
+      it->resize(wordCount, 0);
+
+    if ( triggerMask.acceptAll() )
+    {
+      acceptAll_[consumer/64] |= consumerBit;
+      return;
+    }
+
+    const Words& mask = triggerMask.mask();
+    if ( consumersByPath_.size() < mask.size() * 64 )
+      consumersByPath_.resize(mask.size() * 64, Words(wordCount, 0));
+
+    for (size_t path = 0; path < mask.size() * 64; ++path)
+    {
+      if ( ( mask[path/64] >> (path%64) ) & 1 )
+        consumersByPath_[path][consumer/64] |= consumerBit;
+    }
+  }
+  
+  
+  void TriggerMaskSet::getAcceptingConsumers
+  (
+    const Words& acceptedPaths,
+    Words& consumers
+  ) const
+  {
+    consumers = acceptAll_;
+
+    const size_t wordCount = std::min(acceptedPaths.size(), (consumersByPath_.size() + 63) / 64);
+    for (size_t word = 0; word < wordCount; ++word)
+    {
+      // Only visit the paths which accepted the event
+      for (uint64_t paths = acceptedPaths[word]; paths; paths &= paths - 1)
+      {
+        const size_t path = word * 64 + __builtin_ctzll(paths);
+        if ( path >= consumersByPath_.size() ) break;
+
+        const Words& pathConsumers = consumersByPath_[path];
+        for (size_t i = 0; i < consumers.size(); ++i)
+          consumers[i] |= pathConsumers[i];
+      }
+    }
+  }
+  
+  
+  bool TriggerMask::getPathPatterns
+  (
+    const std::string& triggerSelection,
+    const Strings& eventSelection,
+    Strings& patterns
+  )
+  {
+    patterns.clear();
+
+    if ( triggerSelection.empty() )
+    {
+      for ( Strings::const_iterator it = eventSelection.begin(), itEnd = eventSelection.end();
+            it != itEnd; ++it )
+      {
+        if ( ! isPathPattern(*it) ) return false;
+        patterns.push_back(*it);
+      }
+      return true;
+    }
+
+    // Only accept a list of paths separated by 'OR'
+    std::istringstream selection(triggerSelection);
+    std::string token;
+    bool expectPath(true);
+    while ( selection >> token )
+    {
+      if ( expectPath )
+      {
+        if ( ! isPathPattern(token) ) return false;
+        patterns.push_back(token);
+      }
+      else if ( token != "OR" )
+      {
+        return false;
+      }
+      expectPath = ! expectPath;
+    }
+
+    return ! expectPath;
+  }
+  
+  
+  bool TriggerMask::isPathPattern(const std::string& path)
+  {
+    if ( path.empty() || path == "OR" || path == "AND" || path == "NOT" ) return false;
+
+    for ( std::string::const_iterator it = path.begin(), itEnd = path.end();
+          it != itEnd; ++it )
+    {
+      const char c = *it;
+      if ( ! ( (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+          (c >= '0' && c <= '9') || c == '_' || c == '*' || c == '?' ) )
+        return false;
+    }
+
+    return true;
+  }
+  
+  
+  bool TriggerMask::matches(const char* pattern, const char* name)
+  {
+    if ( *pattern == '\0' ) return ( *name == '\0' );
+
+    if ( *pattern == '*' )
+    {
+      return ( matches(pattern+1, name) ||
+        ( *name != '\0' && matches(pattern, name+1) ) );
+    }
+
+    if ( *name == '\0' ) return false;
+
+    if ( *pattern == '?' || *pattern == *name )
+      return matches(pattern+1, name+1);
+
+    return false;
+  }
+
+} // namespace smproxy
+  
+/// emacs configuration
+/// Local Variables: -
+/// mode: c++ -
+/// c-basic-offset: 2 -
+/// indent-tabs-mode: nil -
+/// End: -
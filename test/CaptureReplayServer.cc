@@ -0,0 +1,140 @@
+// $Id$
+/// @file: CaptureReplayServer.cc
+
+#include "EventFilter/SMProxyServer/test/CaptureReplayServer.h"
+
+#include "IOPool/Streamer/interface/MsgHeader.h"
+
+
+namespace smproxy
+{
+  CaptureReplayServer::CaptureReplayServer
+  (
+    const MockEventServerParams& params,
+    const FileNames& captureFiles,
+    const double speedUp,
+    const bool loop
+  ) :
+  MockEventServer(params),
+  speedUp_(speedUp),
+  loop_(loop)
+  {
+    for ( FileNames::const_iterator it = captureFiles.begin(),
+            itEnd = captureFiles.end(); it != itEnd; ++it )
+    {
+      Stream stream;
+      stream.reader.reset( new EventCaptureReader(*it) );
+      streams_.push_back(stream);
+    }
+    restart();
+  }
+  
+  
+  CaptureReplayServer::~CaptureReplayServer()
+  {
+    stop();
+  }
+  
+  
+  bool CaptureReplayServer::done() const
+  {
+    boost::mutex::scoped_lock sl(streamsMutex_);
+    for ( Streams::const_iterator it = streams_.begin(), itEnd = streams_.end();
+          it != itEnd; ++it )
+    {
+      if ( it->valid ) return false;
+    }
+    return true;
+  }
+  
+  
+  bool CaptureReplayServer::getNextEvent(Buffer& buffer)
+  {
+    return getNextMessage(Header::EVENT, buffer);
+  }
+  
+  
+  bool CaptureReplayServer::getNextDQMEvent(Buffer& buffer)
+  {
+    return getNextMessage(Header::DQM_EVENT, buffer);
+  }
+  
+  
+  void CaptureReplayServer::getInitMsg(Buffer& buffer)
+  {
+    boost::mutex::scoped_lock sl(streamsMutex_);
+    if ( capturedInitMsg_.empty() )
+      MockEventServer::getInitMsg(buffer);
+    else
+      buffer = capturedInitMsg_;
+  }
+  
+  
+  bool CaptureReplayServer::getNextMessage(const uint32_t code, Buffer& buffer)
+  {
+    boost::mutex::scoped_lock sl(streamsMutex_);
+
+    const uint64_t elapsed =
+      (stor::utils::getCurrentTime() - startTime_).total_microseconds();
+    bool anyValid = false;
+
+    // Serve the oldest due message of the requested type
+    Streams::iterator oldest = streams_.end();
+    for ( Streams::iterator it = streams_.begin(), itEnd = streams_.end();
+          it != itEnd; ++it )
+    {
+      if ( ! it->valid ) continue;
+      anyValid = true;
+
+      if ( HeaderView(&it->next.data[0]).code() != code ) continue;
+      if ( speedUp_ > 0 && it->next.offset / speedUp_ > elapsed ) continue;
+      if ( oldest == streams_.end() || it->next.offset < oldest->next.offset )
+        oldest = it;
+    }
+
+    if ( ! anyValid && loop_ ) restart();
+
+    if ( oldest == streams_.end() ) return false;
+
+    buffer.swap(oldest->next.data);
+    advance(*oldest);
+    return true;
+  }
+  
+  
+  void CaptureReplayServer::advance(Stream& stream)
+  {
+    // INIT messages are not replayed in sequence, but
+    // served whenever the proxy asks for them
+    while ( (stream.valid = stream.reader->next(stream.next)) )
+    {
+      if ( stream.next.data.size() < sizeof(Header) ) continue;
+
+      if ( HeaderView(&stream.next.data[0]).code() != Header::INIT ) return;
+      
+      if ( capturedInitMsg_.empty() )
+        capturedInitMsg_.assign(stream.next.data.begin(), stream.next.data.end());
+    }
+  }
+  
+  
+  void CaptureReplayServer::restart()
+  {
+    for ( Streams::iterator it = streams_.begin(), itEnd = streams_.end();
+          it != itEnd; ++it )
+    {
+      it->reader->rewind();
+      advance(*it);
+    }
+    startTime_ = stor::utils::getCurrentTime();
+  }
+
+} // namespace smproxy
+
+
+/// emacs configuration
+/// Local Variables: -
+/// mode: c++ -
+/// c-basic-offset: 2 -
+/// indent-tabs-mode: nil -
+/// End: -
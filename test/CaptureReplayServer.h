@@ -0,0 +1,91 @@
+// $Id$
+/// @file: CaptureReplayServer.h 
+
+#ifndef EventFilter_SMProxyServer_CaptureReplayServer_h
+#define EventFilter_SMProxyServer_CaptureReplayServer_h
+
+#include "EventFilter/SMProxyServer/interface/EventCapture.h"
+#include "EventFilter/SMProxyServer/test/MockEventServer.h"
+
+#include <boost/shared_ptr.hpp>
+
+#include <string>
+#include <vector>
+
+
+namespace smproxy {
+
+  /**
+   * Plays back the messages recorded with the captureDirectory
+   * option of the SMProxyServer. Each message is served once the
+   * time it was received, divided by the speed-up factor, has passed
+   * since the start of the replay. A speed-up of 0 serves the messages
+   * as fast as they are requested.
+   *
+   * $Author$
+   * $Revision$
+   * $Date$
+   */
+
+  class CaptureReplayServer : public MockEventServer
+  {
+  public:
+
+    typedef std::vector<std::string> FileNames;
+
+    CaptureReplayServer
+    (
+      const MockEventServerParams&,
+      const FileNames& captureFiles,
+      const double speedUp,
+      const bool loop
+    );
+
+    virtual ~CaptureReplayServer();
+
+    /**
+     * Return true once all captured messages have been served
+     */
+    bool done() const;
+
+
+  protected:
+
+    virtual bool getNextEvent(Buffer&);
+    virtual bool getNextDQMEvent(Buffer&);
+    virtual void getInitMsg(Buffer&);
+
+
+  private:
+
+    struct Stream
+    {
+      boost::shared_ptr<EventCaptureReader> reader;
+      CapturedMessage next;
+      bool valid;
+    };
+    typedef std::vector<Stream> Streams;
+
+    bool getNextMessage(const uint32_t code, Buffer&);
+    void advance(Stream&);
+    void restart();
+
+    const double speedUp_;
+    const bool loop_;
+    Streams streams_;
+    Buffer capturedInitMsg_;
+    stor::utils::TimePoint_t startTime_;
+    mutable boost::mutex streamsMutex_;
+  };
+  
+} // namespace smproxy
+
+#endif // EventFilter_SMProxyServer_CaptureReplayServer_h 
+
+
+/// emacs configuration
+/// Local Variables: -
+/// mode: c++ -
+/// c-basic-offset: 2 -
+/// indent-tabs-mode: nil -
+/// End: -
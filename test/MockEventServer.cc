@@ -0,0 +1,422 @@
+// $Id$
+/// @file: MockEventServer.cc
+
+#include "EventFilter/SMProxyServer/test/MockEventServer.h"
+
+#include "IOPool/Streamer/interface/ConsRegMessage.h"
+#include "IOPool/Streamer/interface/EventMessage.h"
+#include "IOPool/Streamer/interface/InitMessage.h"
+#include "IOPool/Streamer/interface/MsgHeader.h"
+
+#include <boost/bind.hpp>
+#include <boost/lexical_cast.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <istream>
+#include <sstream>
+#include <sys/time.h>
+
+
+namespace smproxy
+{
+  MockEventServerParams::MockEventServerParams() :
+  port_(0),
+  outputModuleLabel_("out4DQM"),
+  runNumber_(1),
+  hltPathCount_(64),
+  eventSize_(100000),
+  eventSizeSpread_(0),
+  maxEventRate_(0),
+  latency_(boost::posix_time::seconds(0)),
+  dropRate_(0),
+  errorRate_(0),
+  eventsBeforeDone_(0),
+  seed_(12345)
+  {}
+  
+  
+  MockEventServer::Stats::Stats() :
+  requests(0),
+  events(0),
+  bytes(0),
+  droppedConnections(0),
+  errorReplies(0)
+  {}
+  
+  
+  MockEventServer::MockEventServer(const MockEventServerParams& params) :
+  params_(params),
+  acceptor_(ioService_,
+    boost::asio::ip::tcp::endpoint(boost::asio::ip::tcp::v4(), params.port_)),
+  nextEventNumber_(1),
+  nextConsumerId_(1),
+  eventRate_(params.maxEventRate_, std::max(params.maxEventRate_/10, 1.)),
+  dropRate_(params.dropRate_),
+  errorRate_(params.errorRate_),
+  randomState_(params.seed_),
+  stopping_(false)
+  {
+    buildInitMsg();
+  }
+  
+  
+  void MockEventServer::start()
+  {
+    acceptThread_.reset(
+      new boost::thread( boost::bind( &MockEventServer::acceptConnections, this) )
+    );
+  }
+  
+  
+  MockEventServer::~MockEventServer()
+  {
+    stop();
+  }
+  
+  
+  std::string MockEventServer::sourceURL() const
+  {
+    std::ostringstream url;
+    url << "http://localhost:" << port();
+    return url.str();
+  }
+  
+  
+  unsigned short MockEventServer::port() const
+  {
+    return acceptor_.local_endpoint().port();
+  }
+  
+  
+  void MockEventServer::setFailureRates(const double dropRate, const double errorRate)
+  {
+    boost::mutex::scoped_lock sl(mutex_);
+    dropRate_ = dropRate;
+    errorRate_ = errorRate;
+  }
+  
+  
+  void MockEventServer::stop()
+  {
+    {
+      boost::mutex::scoped_lock sl(mutex_);
+      if ( stopping_ ) return;
+      stopping_ = true;
+    }
+    
+    // Closing the acceptor does not reliably interrupt a blocking
+    // accept. Thus, wake it up with a last connection.
+    boost::system::error_code ec;
+    if ( acceptThread_ )
+    {
+      Socket wakeUp(ioService_);
+      wakeUp.connect(boost::asio::ip::tcp::endpoint(
+          boost::asio::ip::address_v4::loopback(), port()), ec);
+      acceptThread_->join();
+    }
+    acceptor_.close(ec);
+    
+    boost::mutex::scoped_lock sl(socketsMutex_);
+    for ( std::set<SocketPtr>::const_iterator it = sockets_.begin(),
+            itEnd = sockets_.end(); it != itEnd; ++it )
+    {
+      (*it)->shutdown(boost::asio::ip::tcp::socket::shutdown_both, ec);
+    }
+    while ( ! sockets_.empty() ) socketsClosed_.wait(sl);
+  }
+  
+  
+  MockEventServer::Stats MockEventServer::getStats() const
+  {
+    boost::mutex::scoped_lock sl(mutex_);
+    return stats_;
+  }
+  
+  
+  uint64_t MockEventServer::getCreationTime(const unsigned char* eventData)
+  {
+    uint64_t creationTime;
+    memcpy(&creationTime, eventData, sizeof(creationTime));
+    return creationTime;
+  }
+  
+  
+  uint64_t MockEventServer::now()
+  {
+    timeval tv;
+    gettimeofday(&tv, 0);
+    return static_cast<uint64_t>(tv.tv_sec) * 1000000 + tv.tv_usec;
+  }
+  
+  
+  double MockEventServer::random()
+  {
+    // Must be called with mutex_ held
+    randomState_ = randomState_ * 1103515245 + 12345;
+    return (randomState_ >> 8) / 16777216.;
+  }
+  
+  
+  void MockEventServer::acceptConnections()
+  {
+    while ( true )
+    {
+      SocketPtr socket( new Socket(ioService_) );
+      boost::system::error_code ec;
+      acceptor_.accept(*socket, ec);
+      if ( ec ) return;
+      {
+        boost::mutex::scoped_lock sl(mutex_);
+        if ( stopping_ ) return;
+      }
+      
+      // The connection threads are detached to release their resources
+      // as soon as the client closes the connection.
+      boost::mutex::scoped_lock sl(socketsMutex_);
+      sockets_.insert(socket);
+      boost::thread( boost::bind( &MockEventServer::serveConnection, this, socket ) ).detach();
+    }
+  }
+  
+  
+  void MockEventServer::serveConnection(SocketPtr socket)
+  {
+    std::string path;
+    Buffer reply;
+    
+    while ( readRequest(*socket, path) )
+    {
+      bool drop;
+      bool error;
+      {
+        boost::mutex::scoped_lock sl(mutex_);
+        if ( stopping_ ) break;
+        ++stats_.requests;
+        drop = ( random() < dropRate_ );
+        error = ( random() < errorRate_ );
+        if ( drop ) ++stats_.droppedConnections;
+        else if ( error ) ++stats_.errorReplies;
+      }
+      
+      if ( ! params_.latency_.is_not_a_date_time() &&
+        params_.latency_ > boost::posix_time::seconds(0) )
+        boost::this_thread::sleep(params_.latency_);
+      
+      if ( drop ) break;
+      
+      reply.clear();
+      if ( error )
+      {
+        writeReply(*socket, 500, reply);
+        continue;
+      }
+      
+      if ( path == "/registerConsumer" || path == "/registerDQMConsumer" )
+        buildConsRegResponse(reply);
+      else if ( path == "/getregdata" )
+        getInitMsg(reply);
+      else if ( path == "/geteventdata" )
+      {
+        if ( getNextEvent(reply) ) countEvent(reply.size());
+      }
+      else if ( path == "/getDQMeventdata" )
+      {
+        if ( getNextDQMEvent(reply) ) countEvent(reply.size());
+      }
+      
+      writeReply(*socket, 200, reply);
+    }
+    
+    boost::system::error_code ec;
+    socket->close(ec);
+    
+    boost::mutex::scoped_lock sl(socketsMutex_);
+    sockets_.erase(socket);
+    socketsClosed_.notify_all();
+  }
+  
+  
+  bool MockEventServer::readRequest(Socket& socket, std::string& path)
+  {
+    boost::asio::streambuf request;
+    boost::system::error_code ec;
+    
+    const size_t headerLength =
+      boost::asio::read_until(socket, request, "\r\n\r\n", ec);
+    if ( ec ) return false;
+    
+    std::istream is(&request);
+    std::string method, version;
+    is >> method >> path >> version;
+    const size_t query = path.find('?');
+    if ( query != std::string::npos ) path.erase(query);
+    
+    size_t contentLength = 0;
+    std::string line;
+    std::getline(is, line);
+    while ( std::getline(is, line) && line != "\r" )
+    {
+      std::transform(line.begin(), line.end(), line.begin(), ::tolower);
+      if ( line.compare(0, 15, "content-length:") == 0 )
+        contentLength = atoi(line.c_str() + 15);
+    }
+    
+    // Discard the request body, e.g. the consumer parameter set
+    const size_t buffered = request.size();
+    if ( contentLength > buffered )
+    {
+      boost::asio::read(socket, request,
+        boost::asio::transfer_at_least(contentLength - buffered), ec);
+      if ( ec ) return false;
+    }
+    return ( headerLength > 0 );
+  }
+  
+  
+  void MockEventServer::writeReply
+  (
+    Socket& socket,
+    const unsigned int status,
+    const Buffer& body
+  )
+  {
+    std::ostringstream header;
+    header << "HTTP/1.1 " << status
+      << (status == 200 ? " OK" : " Internal Server Error") << "\r\n"
+      << "Content-Type: application/octet-stream\r\n"
+      << "Content-Length: " << body.size() << "\r\n"
+      << "Connection: keep-alive\r\n\r\n";
+    const std::string headerStr = header.str();
+    
+    std::vector<boost::asio::const_buffer> buffers;
+    buffers.push_back( boost::asio::buffer(headerStr) );
+    if ( ! body.empty() )
+      buffers.push_back( boost::asio::buffer(&body[0], body.size()) );
+    
+    boost::system::error_code ec;
+    boost::asio::write(socket, buffers, ec);
+  }
+  
+  
+  void MockEventServer::getInitMsg(Buffer& buffer)
+  {
+    buffer = initMsg_;
+  }
+  
+  
+  bool MockEventServer::getNextEvent(Buffer& buffer)
+  {
+    {
+      boost::mutex::scoped_lock sl(mutex_);
+      
+      if ( params_.eventsBeforeDone_ > 0 && stats_.events >= params_.eventsBeforeDone_ )
+      {
+        buildDoneMsg(buffer);
+        return false;
+      }
+      if ( ! eventRate_.tryConsume(stor::utils::getCurrentTime()) )
+        return false;
+    }
+    buildEventMsg(buffer);
+    return true;
+  }
+  
+  
+  bool MockEventServer::getNextDQMEvent(Buffer&)
+  {
+    return false;
+  }
+  
+  
+  void MockEventServer::countEvent(const size_t size)
+  {
+    boost::mutex::scoped_lock sl(mutex_);
+    ++stats_.events;
+    stats_.bytes += size;
+  }
+  
+  
+  void MockEventServer::buildInitMsg()
+  {
+    Strings hltNames;
+    for ( uint32_t i = 0; i < params_.hltPathCount_; ++i )
+      hltNames.push_back( "HLT_Path" + boost::lexical_cast<std::string>(i) );
+    const Strings hltSelections(1, "*");
+    const Strings l1Names;
+    const uint8 psetId[16] = {0};
+    
+    initMsg_.resize(1000 + params_.hltPathCount_ * 32);
+    InitMsgBuilder builder(&initMsg_[0], initMsg_.size(), params_.runNumber_,
+      Version(psetId), "CMSSW_MOCK", "HLT", params_.outputModuleLabel_.c_str(),
+      1, hltNames, hltSelections, l1Names, 0, "localhost");
+    builder.setDataLength(0);
+    initMsg_.resize(builder.size());
+  }
+  
+  
+  void MockEventServer::buildEventMsg(Buffer& buffer)
+  {
+    uint32_t eventNumber;
+    size_t eventSize = params_.eventSize_;
+    std::vector<uint8> hltBits((params_.hltPathCount_ + 3) / 4, 0);
+    {
+      boost::mutex::scoped_lock sl(mutex_);
+      eventNumber = nextEventNumber_++;
+      if ( params_.eventSizeSpread_ > 0 )
+        eventSize += static_cast<size_t>(
+          (2 * random() - 1) * params_.eventSizeSpread_);
+      for ( uint32_t i = 0; i < params_.hltPathCount_; ++i )
+      {
+        // hlt::Pass is 1, hlt::Fail is 2
+        const uint8 state = ( random() < 0.5 ) ? 1 : 2;
+        hltBits[i/4] |= state << ((i%4)*2);
+      }
+    }
+    eventSize = std::max(eventSize, sizeof(uint64_t));
+    
+    std::vector<bool> l1Bits;
+    buffer.resize(eventSize + 1000 + hltBits.size());
+    EventMsgBuilder builder(&buffer[0], buffer.size(), params_.runNumber_,
+      eventNumber, 1, 1, 0, l1Bits, &hltBits[0], params_.hltPathCount_,
+      0, "localhost");
+    
+    uint8* payload = builder.eventAddr();
+    const uint64_t creationTime = now();
+    memset(payload, 0, eventSize);
+    memcpy(payload, &creationTime, sizeof(creationTime));
+    builder.setOrigDataSize(0);
+    builder.setEventLength(eventSize);
+    buffer.resize(builder.size());
+  }
+  
+  
+  void MockEventServer::buildConsRegResponse(Buffer& buffer)
+  {
+    uint32_t consumerId;
+    {
+      boost::mutex::scoped_lock sl(mutex_);
+      consumerId = nextConsumerId_++;
+    }
+    buffer.resize(100);
+    ConsRegResponseBuilder builder(&buffer[0], buffer.size(), 0, consumerId);
+    buffer.resize(builder.size());
+  }
+  
+  
+  void MockEventServer::buildDoneMsg(Buffer& buffer)
+  {
+    buffer.resize(sizeof(Header));
+    OtherMessageBuilder builder(&buffer[0], Header::DONE);
+    buffer.resize(builder.size());
+  }
+
+} // namespace smproxy
+
+
+/// emacs configuration
+/// Local Variables: -
+/// mode: c++ -
+/// c-basic-offset: 2 -
+/// indent-tabs-mode: nil -
+/// End: -
@@ -0,0 +1,199 @@
+// $Id$
+/// @file: MockEventServer.h 
+
+#ifndef EventFilter_SMProxyServer_MockEventServer_h
+#define EventFilter_SMProxyServer_MockEventServer_h
+
+#include "EventFilter/SMProxyServer/interface/TokenBucket.h"
+#include "EventFilter/StorageManager/interface/Utils.h"
+
+#include <boost/asio.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+
+#include <set>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+
+namespace smproxy {
+
+  /**
+   * Configuration of the MockEventServer
+   */
+  struct MockEventServerParams
+  {
+    unsigned short port_;             // 0 lets the OS pick a free port
+    std::string outputModuleLabel_;
+    uint32_t runNumber_;
+    uint32_t hltPathCount_;
+    size_t eventSize_;                // Bytes
+    size_t eventSizeSpread_;          // Bytes, uniformly +/- around eventSize_
+    double maxEventRate_;             // Hz, 0 for unlimited
+    stor::utils::Duration_t latency_; // added to each reply
+    double dropRate_;                 // probability to drop the connection
+    double errorRate_;                // probability to reply with HTTP 500
+    uint32_t eventsBeforeDone_;       // send DONE after this many events, 0 for never
+    uint32_t seed_;
+
+    MockEventServerParams();
+  };
+
+
+  /**
+   * A stand-in for the event server of a StorageManager.
+   *
+   * It answers the HTTP requests of the stor::EventServerProxy with
+   * synthetic INIT and event messages. The first 8 Bytes of the event
+   * payload hold the creation time in microseconds since the epoch.
+   * DQM event requests are never answered with an event. Derived
+   * classes can serve other messages by overriding the getters.
+   *
+   * $Author$
+   * $Revision$
+   * $Date$
+   */
+
+  class MockEventServer
+  {
+  public:
+
+    struct Stats
+    {
+      uint64_t requests;
+      uint64_t events;
+      uint64_t bytes;
+      uint64_t droppedConnections;
+      uint64_t errorReplies;
+
+      Stats();
+    };
+
+    explicit MockEventServer(const MockEventServerParams&);
+
+    virtual ~MockEventServer();
+
+    /**
+     * Start serving requests
+     */
+    void start();
+
+    /**
+     * Return the URL to be used in the SMRegistrationList
+     */
+    std::string sourceURL() const;
+
+    /**
+     * Return the port the server listens to
+     */
+    unsigned short port() const;
+
+    /**
+     * Change the failure injection at run time
+     */
+    void setFailureRates(const double dropRate, const double errorRate);
+
+    /**
+     * Stop serving and close all open connections
+     */
+    void stop();
+
+    /**
+     * Return the statistics of served requests
+     */
+    Stats getStats() const;
+
+    /**
+     * Return the creation time in microseconds since the epoch
+     * stored in the payload of a synthetic event
+     */
+    static uint64_t getCreationTime(const unsigned char* eventData);
+
+    /**
+     * Return the current time in microseconds since the epoch
+     */
+    static uint64_t now();
+
+
+  protected:
+
+    typedef std::vector<char> Buffer;
+
+    /**
+     * Fill the buffer with the next event message.
+     * Returns false if no event is available.
+     */
+    virtual bool getNextEvent(Buffer&);
+
+    /**
+     * Fill the buffer with the next DQM event message.
+     * Returns false if no DQM event is available.
+     */
+    virtual bool getNextDQMEvent(Buffer&);
+
+    /**
+     * Fill the buffer with the INIT message
+     */
+    virtual void getInitMsg(Buffer&);
+
+    /**
+     * Return a uniformly distributed random number in [0,1)
+     */
+    double random();
+
+    const MockEventServerParams params_;
+
+
+  private:
+
+    typedef boost::asio::ip::tcp::socket Socket;
+    typedef boost::shared_ptr<Socket> SocketPtr;
+
+    void acceptConnections();
+    void serveConnection(SocketPtr);
+    bool readRequest(Socket&, std::string& path);
+    void writeReply(Socket&, const unsigned int status, const Buffer&);
+    void countEvent(const size_t size);
+    void buildInitMsg();
+    void buildEventMsg(Buffer&);
+    void buildConsRegResponse(Buffer&);
+    void buildDoneMsg(Buffer&);
+
+    //Prevent copying of the MockEventServer
+    MockEventServer(MockEventServer const&);
+    MockEventServer& operator=(MockEventServer const&);
+
+    boost::asio::io_service ioService_;
+    boost::asio::ip::tcp::acceptor acceptor_;
+    boost::scoped_ptr<boost::thread> acceptThread_;
+    std::set<SocketPtr> sockets_;
+    mutable boost::mutex socketsMutex_;
+    boost::condition_variable socketsClosed_;
+
+    Buffer initMsg_;
+    uint32_t nextEventNumber_;
+    uint32_t nextConsumerId_;
+    TokenBucket eventRate_;
+    double dropRate_;
+    double errorRate_;
+    uint32_t randomState_;
+    bool stopping_;
+    Stats stats_;
+    mutable boost::mutex mutex_;
+  };
+  
+} // namespace smproxy
+
+#endif // EventFilter_SMProxyServer_MockEventServer_h 
+
+
+/// emacs configuration
+/// Local Variables: -
+/// mode: c++ -
+/// c-basic-offset: 2 -
+/// indent-tabs-mode: nil -
+/// End: -
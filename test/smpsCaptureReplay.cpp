@@ -0,0 +1,76 @@
+// $Id$
+/// @file: smpsCaptureReplay.cpp
+//
+// Plays back capture files recorded by an SMProxyServer configured
+// with a captureDirectory. Point the SMRegistrationList of the proxy
+// under test to the printed URL to reproduce the recorded load.
+
+#include "EventFilter/SMProxyServer/test/CaptureReplayServer.h"
+
+#include <csignal>
+#include <cstdlib>
+#include <iostream>
+#include <unistd.h>
+
+namespace
+{
+  volatile sig_atomic_t stopRequested = 0;
+  
+  void requestStop(int) { stopRequested = 1; }
+  
+  void usage(const char* name)
+  {
+    std::cerr << "Usage: " << name << " [options] captureFile...\n"
+      << "  -p port             port to listen to (default: any free port)\n"
+      << "  -x factor           speed-up factor, 0 for as fast as possible (default: 1)\n"
+      << "  -l                  loop over the capture files\n"
+      << std::endl;
+  }
+}
+
+
+int main(int argc, char* argv[])
+{
+  smproxy::MockEventServerParams params;
+  double speedUp = 1;
+  bool loop = false;
+  
+  int opt;
+  while ( (opt = getopt(argc, argv, "p:x:lh")) != -1 )
+  {
+    switch (opt)
+    {
+      case 'p': params.port_ = atoi(optarg); break;
+      case 'x': speedUp = atof(optarg); break;
+      case 'l': loop = true; break;
+      default: usage(argv[0]); return 1;
+    }
+  }
+  if ( optind == argc ) { usage(argv[0]); return 1; }
+  
+  const smproxy::CaptureReplayServer::FileNames captureFiles(argv + optind, argv + argc);
+  
+  signal(SIGINT, requestStop);
+  signal(SIGTERM, requestStop);
+  
+  smproxy::CaptureReplayServer server(params, captureFiles, speedUp, loop);
+  server.start();
+  std::cout << server.sourceURL() << std::endl;
+  
+  while ( ! stopRequested && ! server.done() ) sleep(1);
+  
+  server.stop();
+  const smproxy::MockEventServer::Stats stats = server.getStats();
+  std::cout << "Replayed " << stats.events << " events ("
+    << stats.bytes << " Bytes) in " << stats.requests << " requests" << std::endl;
+  
+  return 0;
+}
+
+
+/// emacs configuration
+/// Local Variables: -
+/// mode: c++ -
+/// c-basic-offset: 2 -
+/// indent-tabs-mode: nil -
+/// End: -
@@ -0,0 +1,515 @@
+// $Id$
+/// @file: smpsMicroBenchmarks.cpp
+//
+// Microbenchmarks of the per-event operations on the SMProxyServer
+// data path. Each benchmark runs for a minimum time with 1 or more
+// threads and reports one CSV line:
+//   benchmark,payload,consumers,threads,operations,seconds,ns_per_op,ops_per_s
+// The payload is given in Bytes for events and in histograms for DQM events.
+
+#include "EventFilter/SMProxyServer/interface/DataRetrieverMonitorCollection.h"
+#include "EventFilter/SMProxyServer/interface/DQMEventMsg.h"
+#include "EventFilter/SMProxyServer/interface/EventMsg.h"
+#include "EventFilter/SMProxyServer/interface/EventQueueCollection.h"
+#include "EventFilter/SMProxyServer/interface/StateMachine.h"
+#include "EventFilter/StorageManager/interface/DQMEventStore.h"
+#include "EventFilter/StorageManager/interface/EventConsumerRegistrationInfo.h"
+#include "EventFilter/StorageManager/src/DQMEventStore.icc"
+#include "EventFilter/StorageManager/test/MockApplication.h"
+#include "IOPool/Streamer/interface/DQMEventMessage.h"
+#include "IOPool/Streamer/interface/EventMessage.h"
+#include "IOPool/Streamer/interface/StreamDQMSerializer.h"
+
+#include "TH1F.h"
+
+#include <boost/bind.hpp>
+#include <boost/function.hpp>
+#include <boost/thread/barrier.hpp>
+#include <boost/thread/thread.hpp>
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <stdint.h>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+
+namespace
+{
+  typedef std::vector<unsigned char> Buffer;
+  typedef boost::function<void()> Operation;
+  typedef boost::function<Operation()> OperationFactory;
+
+  double minSeconds = 0.5;
+  std::string filter;
+
+  const size_t eventSizes[] = { 1000, 100000, 1000000, 10000000 };
+  const size_t histogramCounts[] = { 10, 100, 1000 };
+  const size_t consumerCounts[] = { 1, 8, 64 };
+  const size_t threadCounts[] = { 1, 4 };
+
+  #define ARRAY_END(a) ((a) + sizeof(a)/sizeof(a[0]))
+
+
+  /**
+   * Run the operations created by the factory in the given number of
+   * threads until minSeconds have passed. Each thread gets its own
+   * operation to allow for thread-local state.
+   */
+  void measure
+  (
+    const std::string& benchmark,
+    const size_t payload,
+    const size_t consumers,
+    const size_t threads,
+    const OperationFactory& factory
+  );
+
+
+  struct Worker
+  {
+    Operation operation;
+    uint64_t operations;
+
+    void run(boost::barrier* barrier, volatile bool* stop)
+    {
+      barrier->wait();
+      while ( ! *stop )
+      {
+        for ( int i = 0; i < 16; ++i ) operation();
+        operations += 16;
+      }
+    }
+  };
+
+
+  void measure
+  (
+    const std::string& benchmark,
+    const size_t payload,
+    const size_t consumers,
+    const size_t threads,
+    const OperationFactory& factory
+  )
+  {
+    if ( ! filter.empty() && benchmark.find(filter) == std::string::npos ) return;
+
+    std::vector<Worker> workers(threads);
+    for ( std::vector<Worker>::iterator it = workers.begin(), itEnd = workers.end();
+          it != itEnd; ++it )
+    {
+      it->operation = factory();
+      it->operations = 0;
+    }
+
+    boost::barrier barrier(threads + 1);
+    volatile bool stop = false;
+    boost::thread_group threadGroup;
+    for ( size_t i = 0; i < threads; ++i )
+    {
+      threadGroup.create_thread(
+        boost::bind(&Worker::run, &workers[i], &barrier, &stop)
+      );
+    }
+
+    barrier.wait();
+    const stor::utils::TimePoint_t startTime = stor::utils::getCurrentTime();
+    boost::this_thread::sleep( stor::utils::secondsToDuration(minSeconds) );
+    stop = true;
+    threadGroup.join_all();
+    const double seconds =
+      stor::utils::durationToSeconds(stor::utils::getCurrentTime() - startTime);
+
+    uint64_t operations = 0;
+    for ( std::vector<Worker>::const_iterator it = workers.begin(), itEnd = workers.end();
+          it != itEnd; ++it )
+      operations += it->operations;
+
+    std::cout << benchmark << "," << payload << "," << consumers << ","
+      << threads << "," << operations << "," << seconds << ","
+      << ( operations > 0 ? seconds * 1e9 / operations : 0 ) << ","
+      << operations / seconds << std::endl;
+  }
+
+
+  void buildEventMsg(const size_t payload, Buffer& buffer)
+  {
+    std::vector<bool> l1Bits;
+    std::vector<uint8> hltBits(16, 0x55); // 64 paths passed
+    buffer.resize(payload + 1000);
+    EventMsgBuilder builder(&buffer[0], buffer.size(), 1, 1, 1, 1, 0,
+      l1Bits, &hltBits[0], 64, 0, "localhost");
+    memset(builder.eventAddr(), 0xa5, payload);
+    builder.setOrigDataSize(0);
+    builder.setEventLength(payload);
+    buffer.resize(builder.size());
+  }
+
+
+  void buildDQMEventMsg(const size_t histograms, const uint32_t update, Buffer& buffer)
+  {
+    // Spread the histograms over 10 sub folders
+    DQMEvent::TObjectTable table;
+    std::vector<TH1F*> objects;
+    for ( size_t i = 0; i < histograms; ++i )
+    {
+      std::ostringstream name;
+      name << "h" << i;
+      TH1F* histo = new TH1F(name.str().c_str(), "benchmark", 100, 0, 100);
+      histo->SetDirectory(0);
+      histo->Fill(i % 100);
+      std::ostringstream folder;
+      folder << "Benchmark/Folder" << i % 10;
+      table[folder.str()].push_back(histo);
+      objects.push_back(histo);
+    }
+
+    StreamDQMSerializer serializer;
+    serializer.serializeDQMEvent(table, false, 0);
+
+    buffer.resize(serializer.currentSpaceUsed() + histograms * 100 + 10000);
+    DQMEventMsgBuilder builder(&buffer[0], buffer.size(), 1, update,
+      edm::Timestamp(), 1, update, 0, "localhost", "CMSSW_BENCHMARK",
+      "Benchmark", table);
+    memcpy(builder.eventAddress(), serializer.bufferPointer(),
+      serializer.currentEventSize());
+    builder.setEventLength(serializer.currentEventSize());
+    builder.setCompressionFlag(0);
+    buffer.resize(builder.size());
+
+    for ( std::vector<TH1F*>::iterator it = objects.begin(), itEnd = objects.end();
+          it != itEnd; ++it )
+      delete *it;
+  }
+
+
+  stor::QueueIDs createEventQueues
+  (
+    smproxy::StateMachinePtr stateMachine,
+    const size_t count
+  )
+  {
+    stor::QueueIDs queueIDs;
+    for ( size_t i = 0; i < count; ++i )
+    {
+      edm::ParameterSet pset;
+      pset.addUntrackedParameter<std::string>("consumerName", "smpsMicroBenchmarks");
+      pset.addUntrackedParameter<std::string>("SelectHLTOutput", "out4DQM");
+      pset.addUntrackedParameter<int>("queueSize", 10);
+      pset.addUntrackedParameter<std::string>("queuePolicy", "DiscardOld");
+      pset.addUntrackedParameter<double>("consumerTimeOut", 3600);
+
+      stor::EventConsRegPtr regPtr( new stor::EventConsumerRegistrationInfo(pset,
+          stateMachine->getConfiguration()->getEventServingParams(), "localhost")
+      );
+      regPtr->setConsumerId( stateMachine->getRegistrationCollection()->getConsumerId() );
+      queueIDs.push_back( stateMachine->getEventQueueCollection()->createQueue(regPtr) );
+    }
+    return queueIDs;
+  }
+
+
+  ////////////////
+  // Operations //
+  ////////////////
+
+  void constructEventMsg(boost::shared_ptr<Buffer> buffer)
+  {
+    const EventMsgView view(&(*buffer)[0]);
+    const smproxy::EventMsg event(view);
+  }
+
+
+  void constructDQMEventMsg(boost::shared_ptr<Buffer> buffer)
+  {
+    const DQMEventMsgView view(&(*buffer)[0]);
+    const smproxy::DQMEventMsg event(view);
+  }
+
+
+  void tagEvent(boost::shared_ptr<smproxy::EventMsg> event, const stor::QueueIDs& queueIDs)
+  {
+    event->tagForEventConsumers(queueIDs);
+  }
+
+
+  void addEvent
+  (
+    smproxy::EventQueueCollectionPtr eventQueueCollection,
+    const smproxy::EventMsg& event
+  )
+  {
+    eventQueueCollection->addEvent(event);
+  }
+
+
+  void addRetrievedSample
+  (
+    smproxy::DataRetrieverMonitorCollection* collection,
+    const smproxy::ConnectionID connectionId
+  )
+  {
+    collection->addRetrievedSample(connectionId, 100000);
+  }
+
+
+  struct DQMConnection
+  {
+    size_t getConnectedSMCount() const { return 1; }
+  };
+
+  typedef stor::DQMEventStore<smproxy::DQMEventMsg,
+                              DQMConnection,
+                              smproxy::StateMachine> DQMEventStore;
+
+  void addDQMEvent
+  (
+    boost::shared_ptr<DQMEventStore> store,
+    boost::shared_ptr<std::vector<smproxy::DQMEventMsg> > events,
+    boost::shared_ptr<size_t> next
+  )
+  {
+    store->addDQMEvent( (*events)[(*next)++ % events->size()] );
+  }
+
+
+  //////////////////////
+  // Factory wrappers //
+  //////////////////////
+
+  Operation sharedOperation(const Operation& operation)
+  {
+    return operation;
+  }
+
+
+  Operation threadLocalTagging(const boost::shared_ptr<Buffer> buffer, const stor::QueueIDs& queueIDs)
+  {
+    boost::shared_ptr<smproxy::EventMsg> event(
+      new smproxy::EventMsg( EventMsgView(&(*buffer)[0]) )
+    );
+    return boost::bind(&tagEvent, event, queueIDs);
+  }
+
+
+  Operation threadLocalConnection
+  (
+    smproxy::DataRetrieverMonitorCollection* collection,
+    const std::vector<smproxy::ConnectionID>* connectionIDs,
+    boost::shared_ptr<size_t> nextConnection
+  )
+  {
+    // Each thread uses its own connection, wrapping around if
+    // there are more threads than connections
+    const smproxy::ConnectionID connectionId =
+      (*connectionIDs)[(*nextConnection)++ % connectionIDs->size()];
+    return boost::bind(&addRetrievedSample, collection, connectionId);
+  }
+
+
+  Operation threadLocalDQMStore
+  (
+    smproxy::StateMachinePtr stateMachine,
+    DQMConnection* connection,
+    boost::shared_ptr<std::vector<smproxy::DQMEventMsg> > events
+  )
+  {
+    boost::shared_ptr<DQMEventStore> store( new DQMEventStore(
+        stateMachine->getApplicationDescriptor(),
+        stateMachine->getDQMEventQueueCollection(),
+        stateMachine->getStatisticsReporter()->getDQMEventMonitorCollection(),
+        connection,
+        &DQMConnection::getConnectedSMCount,
+        stateMachine.get(),
+        &smproxy::StateMachine::moveToFailedState,
+        stateMachine->getStatisticsReporter()->alarmHandler()
+      ) );
+    store->setParameters(stateMachine->getConfiguration()->getDQMProcessingParams());
+    return boost::bind(&addDQMEvent, store, events, boost::shared_ptr<size_t>(new size_t(0)));
+  }
+
+
+  void usage(const char* name)
+  {
+    std::cerr << "Usage: " << name << " [options]\n"
+      << "  -t s       minimum time per benchmark (default: 0.5)\n"
+      << "  -f name    only run benchmarks containing name\n"
+      << std::endl;
+  }
+}
+
+
+namespace stor {
+
+  template<>  
+  DQMEventMsgView
+  DQMEventStore<smproxy::DQMEventMsg, DQMConnection, smproxy::StateMachine>::
+  getDQMEventView(smproxy::DQMEventMsg const& dqmEvent)
+  {
+    return DQMEventMsgView(dqmEvent.dataLocation());
+  }
+
+} // namespace stor
+
+
+int main(int argc, char* argv[])
+{
+  int opt;
+  while ( (opt = getopt(argc, argv, "t:f:h")) != -1 )
+  {
+    switch (opt)
+    {
+      case 't': minSeconds = atof(optarg); break;
+      case 'f': filter = optarg; break;
+      default: usage(argv[0]); return 1;
+    }
+  }
+
+  smproxy::StateMachinePtr stateMachine(
+    new smproxy::StateMachine(mockapps::getMockXdaqApplication())
+  );
+  // Configuring is done asynchronously
+  stateMachine->processEvent( smproxy::Configure() );
+  while ( stateMachine->getExternallyVisibleStateName() != "Ready" )
+  {
+    if ( stateMachine->getExternallyVisibleStateName() == "Failed" )
+    {
+      std::cerr << stateMachine->getReasonForFailed() << std::endl;
+      return 1;
+    }
+    boost::this_thread::sleep(boost::posix_time::milliseconds(10));
+  }
+
+  std::cout << "benchmark,payload,consumers,threads,operations,seconds,ns_per_op,ops_per_s" << std::endl;
+
+  // EventMsg(const EventMsgView&)
+  for ( const size_t* size = eventSizes; size != ARRAY_END(eventSizes); ++size )
+  {
+    boost::shared_ptr<Buffer> buffer(new Buffer);
+    buildEventMsg(*size, *buffer);
+    for ( const size_t* threads = threadCounts; threads != ARRAY_END(threadCounts); ++threads )
+    {
+      measure("EventMsg", *size, 0, *threads,
+        boost::bind(&sharedOperation, Operation(boost::bind(&constructEventMsg, buffer))));
+    }
+  }
+
+  // DQMEventMsg(const DQMEventMsgView&)
+  for ( const size_t* count = histogramCounts; count != ARRAY_END(histogramCounts); ++count )
+  {
+    boost::shared_ptr<Buffer> buffer(new Buffer);
+    buildDQMEventMsg(*count, 1, *buffer);
+    for ( const size_t* threads = threadCounts; threads != ARRAY_END(threadCounts); ++threads )
+    {
+      measure("DQMEventMsg", *count, 0, *threads,
+        boost::bind(&sharedOperation, Operation(boost::bind(&constructDQMEventMsg, buffer))));
+    }
+  }
+
+  // EventMsg::tagForEventConsumers
+  {
+    boost::shared_ptr<Buffer> buffer(new Buffer);
+    buildEventMsg(eventSizes[1], *buffer);
+    for ( const size_t* consumers = consumerCounts; consumers != ARRAY_END(consumerCounts); ++consumers )
+    {
+      stor::QueueIDs queueIDs;
+      for ( size_t i = 0; i < *consumers; ++i )
+        queueIDs.push_back( stor::QueueID(stor::enums::DiscardOld, i) );
+      for ( const size_t* threads = threadCounts; threads != ARRAY_END(threadCounts); ++threads )
+      {
+        measure("tagForEventConsumers", eventSizes[1], *consumers, *threads,
+          boost::bind(&threadLocalTagging, buffer, queueIDs));
+      }
+    }
+  }
+
+  // EventQueueCollection::addEvent
+  {
+    smproxy::EventQueueCollectionPtr eventQueueCollection =
+      stateMachine->getEventQueueCollection();
+    for ( const size_t* consumers = consumerCounts; consumers != ARRAY_END(consumerCounts); ++consumers )
+    {
+      eventQueueCollection->removeQueues();
+      const stor::QueueIDs queueIDs = createEventQueues(stateMachine, *consumers);
+      for ( const size_t* size = eventSizes; size != ARRAY_END(eventSizes); size += 2 )
+      {
+        Buffer buffer;
+        buildEventMsg(*size, buffer);
+        smproxy::EventMsg event( (EventMsgView(&buffer[0])) );
+        event.tagForEventConsumers(queueIDs);
+        for ( const size_t* threads = threadCounts; threads != ARRAY_END(threadCounts); ++threads )
+        {
+          measure("EventQueueCollection::addEvent", *size, *consumers, *threads,
+            boost::bind(&sharedOperation,
+              Operation(boost::bind(&addEvent, eventQueueCollection, event))));
+        }
+      }
+    }
+    eventQueueCollection->removeQueues();
+  }
+
+  // DataRetrieverMonitorCollection::addRetrievedSample
+  {
+    smproxy::DataRetrieverMonitorCollection& collection =
+      stateMachine->getStatisticsReporter()->getDataRetrieverMonitorCollection();
+    std::vector<smproxy::ConnectionID> connectionIDs;
+    const stor::EventConsRegPtr regPtr( new stor::EventConsumerRegistrationInfo(
+        edm::ParameterSet(), stateMachine->getConfiguration()->getEventServingParams()) );
+    regPtr->setSourceURL("http://localhost");
+    for ( size_t i = 0; i < 16; ++i )
+      connectionIDs.push_back( collection.addNewConnection(regPtr) );
+
+    const size_t contentionThreadCounts[] = { 1, 4, 16 };
+    for ( const size_t* threads = contentionThreadCounts;
+          threads != ARRAY_END(contentionThreadCounts); ++threads )
+    {
+      // single connection: all threads contend for the same statistics
+      const std::vector<smproxy::ConnectionID> single(1, connectionIDs.front());
+      measure("addRetrievedSample_sameConnection", 100000, 0, *threads,
+        boost::bind(&threadLocalConnection, &collection, &single,
+          boost::shared_ptr<size_t>(new size_t(0))));
+      measure("addRetrievedSample_ownConnection", 100000, 0, *threads,
+        boost::bind(&threadLocalConnection, &collection, &connectionIDs,
+          boost::shared_ptr<size_t>(new size_t(0))));
+    }
+  }
+
+  // DQMEventStore::addDQMEvent
+  // The store is only used by the thread of its DQM event retriever.
+  // Thus, each thread gets its own store to show how the collation scales.
+  {
+    DQMConnection connection;
+    for ( const size_t* count = histogramCounts; count != ARRAY_END(histogramCounts); ++count )
+    {
+      // Cycle through updates to let the store collate and serve them
+      boost::shared_ptr<std::vector<smproxy::DQMEventMsg> > events(
+        new std::vector<smproxy::DQMEventMsg> );
+      Buffer buffer;
+      for ( uint32_t update = 1; update <= 10; ++update )
+      {
+        buildDQMEventMsg(*count, update, buffer);
+        events->push_back( smproxy::DQMEventMsg(DQMEventMsgView(&buffer[0])) );
+      }
+      for ( const size_t* threads = threadCounts; threads != ARRAY_END(threadCounts); ++threads )
+      {
+        measure("DQMEventStore::addDQMEvent", *count, 0, *threads,
+          boost::bind(&threadLocalDQMStore, stateMachine, &connection, events));
+      }
+    }
+  }
+
+  stateMachine->processEvent( smproxy::Halt() );
+
+  return 0;
+}
+
+
+/// emacs configuration
+/// Local Variables: -
+/// mode: c++ -
+/// c-basic-offset: 2 -
+/// indent-tabs-mode: nil -
+/// End: -
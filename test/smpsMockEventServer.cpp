@@ -0,0 +1,87 @@
+// $Id$
+/// @file: smpsMockEventServer.cpp
+//
+// Serves synthetic events like a StorageManager event server until
+// interrupted. Point the SMRegistrationList of an SMProxyServer to the
+// printed URL to run it against a fake upstream.
+
+#include "EventFilter/SMProxyServer/test/MockEventServer.h"
+
+#include <csignal>
+#include <cstdlib>
+#include <iostream>
+#include <unistd.h>
+
+namespace
+{
+  volatile sig_atomic_t stopRequested = 0;
+  
+  void requestStop(int) { stopRequested = 1; }
+  
+  void usage(const char* name)
+  {
+    std::cerr << "Usage: " << name << " [options]\n"
+      << "  -p port             port to listen to (default: any free port)\n"
+      << "  -m label            output module label (default: out4DQM)\n"
+      << "  -s bytes            mean event size (default: 100000)\n"
+      << "  -w bytes            event size spread (default: 0)\n"
+      << "  -r Hz               maximum event rate (default: unlimited)\n"
+      << "  -n count            number of HLT paths (default: 64)\n"
+      << "  -l ms               latency added to each reply (default: 0)\n"
+      << "  -d probability      connection drop rate (default: 0)\n"
+      << "  -e probability      HTTP error rate (default: 0)\n"
+      << "  -c count            send DONE after count events (default: never)\n"
+      << std::endl;
+  }
+}
+
+
+int main(int argc, char* argv[])
+{
+  smproxy::MockEventServerParams params;
+  
+  int opt;
+  while ( (opt = getopt(argc, argv, "p:m:s:w:r:n:l:d:e:c:h")) != -1 )
+  {
+    switch (opt)
+    {
+      case 'p': params.port_ = atoi(optarg); break;
+      case 'm': params.outputModuleLabel_ = optarg; break;
+      case 's': params.eventSize_ = atol(optarg); break;
+      case 'w': params.eventSizeSpread_ = atol(optarg); break;
+      case 'r': params.maxEventRate_ = atof(optarg); break;
+      case 'n': params.hltPathCount_ = atoi(optarg); break;
+      case 'l': params.latency_ = boost::posix_time::milliseconds(atoi(optarg)); break;
+      case 'd': params.dropRate_ = atof(optarg); break;
+      case 'e': params.errorRate_ = atof(optarg); break;
+      case 'c': params.eventsBeforeDone_ = atoi(optarg); break;
+      default: usage(argv[0]); return 1;
+    }
+  }
+  
+  signal(SIGINT, requestStop);
+  signal(SIGTERM, requestStop);
+  
+  smproxy::MockEventServer server(params);
+  server.start();
+  std::cout << server.sourceURL() << std::endl;
+  
+  while ( ! stopRequested ) sleep(1);
+  
+  server.stop();
+  const smproxy::MockEventServer::Stats stats = server.getStats();
+  std::cout << "Served " << stats.requests << " requests with "
+    << stats.events << " events (" << stats.bytes << " Bytes), "
+    << stats.droppedConnections << " dropped connections and "
+    << stats.errorReplies << " error replies" << std::endl;
+  
+  return 0;
+}
+
+
+/// emacs configuration
+/// Local Variables: -
+/// mode: c++ -
+/// c-basic-offset: 2 -
+/// indent-tabs-mode: nil -
+/// End: -
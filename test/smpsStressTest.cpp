@@ -0,0 +1,503 @@
+// $Id$
+/// @file: smpsStressTest.cpp
+//
+// Stress and lifecycle test of the SMProxyServer. The proxy retrieves
+// events from in-process MockEventServers while consumers register
+// concurrently, the mock servers drop connections, answer with errors
+// or are restarted, and the proxy is cycled through Enable/Stop.
+//
+// The test fails if
+//   - a transition does not finish within the timeout (deadlock),
+//   - the state machine goes to Failed,
+//   - the number of threads or the resident memory keeps growing
+//     over the cycles.
+// The latency of each transition is reported. The random decisions
+// are taken from a seeded generator; the thread scheduling is not
+// deterministic, but a failing seed usually reproduces.
+
+#include "EventFilter/SMProxyServer/interface/StateMachine.h"
+#include "EventFilter/SMProxyServer/test/MockEventServer.h"
+#include "EventFilter/StorageManager/interface/DQMEventConsumerRegistrationInfo.h"
+#include "EventFilter/StorageManager/interface/EventConsumerRegistrationInfo.h"
+#include "EventFilter/StorageManager/test/MockApplication.h"
+
+#include "xdata/InfoSpace.h"
+#include "xdata/String.h"
+#include "xdata/Vector.h"
+
+#include <boost/bind.hpp>
+#include <boost/thread/thread.hpp>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <dirent.h>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <unistd.h>
+#include <vector>
+
+
+namespace
+{
+  struct StressParams
+  {
+    unsigned int cycles;
+    unsigned int servers;
+    unsigned int registrationThreads;
+    unsigned int enabledMilliseconds;
+    unsigned int transitionTimeout;  // seconds
+    unsigned int maxThreadGrowth;
+    unsigned int maxMemoryGrowthMB;
+    uint32_t seed;
+
+    StressParams() :
+    cycles(20), servers(3), registrationThreads(4), enabledMilliseconds(2000),
+    transitionTimeout(60), maxThreadGrowth(2), maxMemoryGrowthMB(64), seed(1) {}
+  };
+
+
+  /**
+   * Minimal linear congruential generator. Each thread uses its
+   * own instance to keep the sequence independent of the scheduling.
+   */
+  class Random
+  {
+  public:
+    explicit Random(const uint32_t seed) : state_(seed) {}
+    double operator()()
+    {
+      state_ = state_ * 1103515245 + 12345;
+      return (state_ >> 8) / 16777216.;
+    }
+    unsigned int operator()(const unsigned int n)
+    { return static_cast<unsigned int>((*this)() * n); }
+  private:
+    uint32_t state_;
+  };
+
+
+  /**
+   * Aborts the process if the current phase does not finish in time.
+   * The abort leaves a core file showing where the threads are stuck.
+   */
+  class Watchdog
+  {
+  public:
+    Watchdog() : deadline_(boost::posix_time::pos_infin), stop_(false)
+    {
+      thread_.reset( new boost::thread( boost::bind(&Watchdog::watch, this) ) );
+    }
+
+    ~Watchdog()
+    {
+      {
+        boost::mutex::scoped_lock sl(mutex_);
+        stop_ = true;
+      }
+      thread_->join();
+    }
+
+    void arm(const std::string& phase, const unsigned int seconds)
+    {
+      boost::mutex::scoped_lock sl(mutex_);
+      phase_ = phase;
+      deadline_ = stor::utils::getCurrentTime() + boost::posix_time::seconds(seconds);
+    }
+
+    void disarm()
+    {
+      boost::mutex::scoped_lock sl(mutex_);
+      deadline_ = boost::posix_time::pos_infin;
+    }
+
+  private:
+    void watch()
+    {
+      while ( true )
+      {
+        boost::this_thread::sleep(boost::posix_time::milliseconds(100));
+        boost::mutex::scoped_lock sl(mutex_);
+        if ( stop_ ) return;
+        if ( stor::utils::getCurrentTime() > deadline_ )
+        {
+          std::cerr << "Deadlock: " << phase_ << " did not finish in time" << std::endl;
+          abort();
+        }
+      }
+    }
+
+    std::string phase_;
+    stor::utils::TimePoint_t deadline_;
+    bool stop_;
+    boost::mutex mutex_;
+    boost::scoped_ptr<boost::thread> thread_;
+  };
+
+
+  struct LatencyStats
+  {
+    double min;
+    double max;
+    double sum;
+    unsigned int count;
+
+    LatencyStats() : min(1e9), max(0), sum(0), count(0) {}
+
+    void add(const double seconds)
+    {
+      min = std::min(min, seconds);
+      max = std::max(max, seconds);
+      sum += seconds;
+      ++count;
+    }
+
+    void print(const std::string& name) const
+    {
+      std::cout << std::setw(24) << std::left << name << std::fixed << std::setprecision(3)
+        << " min " << min << " s, mean " << (count ? sum / count : 0)
+        << " s, max " << max << " s" << std::endl;
+    }
+  };
+
+
+  size_t threadCount()
+  {
+    size_t count = 0;
+    DIR* dir = opendir("/proc/self/task");
+    if ( ! dir ) return 0;
+    while ( dirent* entry = readdir(dir) )
+      if ( entry->d_name[0] != '.' ) ++count;
+    closedir(dir);
+    return count;
+  }
+
+
+  size_t residentMemoryMB()
+  {
+    long pages = 0;
+    FILE* statm = fopen("/proc/self/statm", "r");
+    if ( ! statm ) return 0;
+    if ( fscanf(statm, "%*d %ld", &pages) != 1 ) pages = 0;
+    fclose(statm);
+    return pages * sysconf(_SC_PAGESIZE) / 0x100000;
+  }
+
+
+  /**
+   * Trigger the transition and wait until the target state is reached.
+   * Returns the latency of the transition in seconds, or a negative value
+   * if the state machine failed.
+   */
+  double transition
+  (
+    smproxy::StateMachinePtr stateMachine,
+    Watchdog& watchdog,
+    const StressParams& params,
+    const boost::statechart::event_base& event,
+    const std::string& targetState
+  )
+  {
+    watchdog.arm("Transition to " + targetState, params.transitionTimeout);
+    const stor::utils::TimePoint_t startTime = stor::utils::getCurrentTime();
+
+    stateMachine->processEvent(event);
+    std::string state;
+    while ( (state = stateMachine->getExternallyVisibleStateName()) != targetState )
+    {
+      if ( state == "Failed" )
+      {
+        std::cerr << "Failed to reach " << targetState << ": "
+          << stateMachine->getReasonForFailed() << std::endl;
+        return -1;
+      }
+      boost::this_thread::sleep(boost::posix_time::milliseconds(1));
+    }
+
+    watchdog.disarm();
+    return stor::utils::durationToSeconds(stor::utils::getCurrentTime() - startTime);
+  }
+
+
+  /**
+   * Registers data and DQM event consumers at random intervals and
+   * drains their queues until asked to stop.
+   */
+  void registerConsumers
+  (
+    smproxy::StateMachinePtr stateMachine,
+    const uint32_t seed,
+    volatile bool* stop
+  )
+  {
+    Random random(seed);
+    std::vector<stor::ConsumerID> eventConsumers;
+    std::vector<stor::ConsumerID> dqmConsumers;
+    stor::RegistrationCollectionPtr registrationCollection =
+      stateMachine->getRegistrationCollection();
+
+    while ( ! *stop )
+    {
+      if ( random() < 0.3 )
+      {
+        std::ostringstream consumerName;
+        consumerName << "smpsStressTest_" << seed << "_" << random(1000);
+
+        stor::RegPtr regPtr;
+        edm::ParameterSet pset;
+        if ( random() < 0.8 )
+        {
+          pset.addUntrackedParameter<std::string>("consumerName", consumerName.str());
+          pset.addUntrackedParameter<std::string>("SelectHLTOutput", "out4DQM");
+          pset.addUntrackedParameter<int>("queueSize", 1 + random(10));
+          pset.addUntrackedParameter<std::string>("queuePolicy",
+            random() < 0.5 ? "DiscardOld" : "DiscardNew");
+          pset.addUntrackedParameter<double>("consumerTimeOut", 1 + random(5));
+          pset.addUntrackedParameter<int>("prescale", 1 + random(3));
+          regPtr.reset( new stor::EventConsumerRegistrationInfo(pset,
+              stateMachine->getConfiguration()->getEventServingParams(), "localhost") );
+        }
+        else
+        {
+          pset.addUntrackedParameter<std::string>("DQMconsumerName", consumerName.str());
+          pset.addUntrackedParameter<std::string>("topLevelFolderName", "*");
+          regPtr.reset( new stor::DQMEventConsumerRegistrationInfo(pset,
+              stateMachine->getConfiguration()->getEventServingParams(), "localhost") );
+        }
+
+        const stor::ConsumerID cid = registrationCollection->getConsumerId();
+        regPtr->setConsumerId(cid);
+        stor::QueueID qid;
+        if ( boost::dynamic_pointer_cast<stor::EventConsumerRegistrationInfo>(regPtr) )
+        {
+          qid = stateMachine->getEventQueueCollection()->createQueue(regPtr);
+          eventConsumers.push_back(cid);
+        }
+        else
+        {
+          qid = stateMachine->getDQMEventQueueCollection()->createQueue(regPtr);
+          dqmConsumers.push_back(cid);
+        }
+        regPtr->setQueueId(qid);
+
+        // Registration is refused while the proxy is not enabled
+        if ( registrationCollection->addRegistrationInfo(regPtr) )
+          stateMachine->getRegistrationQueue()->enqTimedWait(regPtr,
+            boost::posix_time::seconds(1));
+      }
+
+      for ( std::vector<stor::ConsumerID>::const_iterator it = eventConsumers.begin(),
+              itEnd = eventConsumers.end(); it != itEnd; ++it )
+      {
+        if ( random() < 0.5 ) stateMachine->getEventQueueCollection()->popEvent(*it);
+      }
+      for ( std::vector<stor::ConsumerID>::const_iterator it = dqmConsumers.begin(),
+              itEnd = dqmConsumers.end(); it != itEnd; ++it )
+      {
+        stateMachine->getDQMEventQueueCollection()->popEvent(*it);
+      }
+
+      boost::this_thread::sleep(boost::posix_time::milliseconds(random(20)));
+    }
+  }
+
+
+  typedef boost::shared_ptr<smproxy::MockEventServer> MockEventServerPtr;
+  typedef std::vector<MockEventServerPtr> MockEventServers;
+
+
+  /**
+   * Inject failures into the mock event servers while the proxy is enabled
+   */
+  void injectFailures
+  (
+    MockEventServers& servers,
+    std::vector<smproxy::MockEventServerParams>& serverParams,
+    Random& random,
+    const unsigned int milliseconds
+  )
+  {
+    const stor::utils::TimePoint_t endTime = stor::utils::getCurrentTime() +
+      boost::posix_time::milliseconds(milliseconds);
+
+    while ( stor::utils::getCurrentTime() < endTime )
+    {
+      const unsigned int i = random(servers.size());
+      const double action = random();
+
+      if ( action < 0.2 )
+      {
+        // Restart the SM on the same port
+        servers[i]->stop();
+        servers[i].reset();
+        boost::this_thread::sleep(boost::posix_time::milliseconds(random(200)));
+        servers[i].reset( new smproxy::MockEventServer(serverParams[i]) );
+        servers[i]->start();
+      }
+      else if ( action < 0.5 )
+      {
+        servers[i]->setFailureRates(0.1 * random(), 0.1 * random());
+      }
+      else
+      {
+        servers[i]->setFailureRates(0, 0);
+      }
+
+      boost::this_thread::sleep(boost::posix_time::milliseconds(50 + random(200)));
+    }
+
+    for ( MockEventServers::const_iterator it = servers.begin(), itEnd = servers.end();
+          it != itEnd; ++it )
+      (*it)->setFailureRates(0, 0);
+  }
+
+
+  void usage(const char* name)
+  {
+    std::cerr << "Usage: " << name << " [options]\n"
+      << "  -c count   number of Enable/Stop cycles (default: 20)\n"
+      << "  -N count   number of mock event servers (default: 3)\n"
+      << "  -r count   number of registration threads (default: 4)\n"
+      << "  -e ms      time spent enabled per cycle (default: 2000)\n"
+      << "  -t s       transition timeout (default: 60)\n"
+      << "  -s seed    random seed (default: 1)\n"
+      << std::endl;
+  }
+}
+
+
+int main(int argc, char* argv[])
+{
+  StressParams params;
+
+  int opt;
+  while ( (opt = getopt(argc, argv, "c:N:r:e:t:s:h")) != -1 )
+  {
+    switch (opt)
+    {
+      case 'c': params.cycles = atoi(optarg); break;
+      case 'N': params.servers = atoi(optarg); break;
+      case 'r': params.registrationThreads = atoi(optarg); break;
+      case 'e': params.enabledMilliseconds = atoi(optarg); break;
+      case 't': params.transitionTimeout = atoi(optarg); break;
+      case 's': params.seed = strtoul(optarg, 0, 10); break;
+      default: usage(argv[0]); return 1;
+    }
+  }
+  std::cout << "Seed: " << params.seed << std::endl;
+
+  Random random(params.seed);
+  MockEventServers servers;
+  std::vector<smproxy::MockEventServerParams> serverParams;
+  xdata::Vector<xdata::String> smRegistrationList;
+  for ( unsigned int i = 0; i < params.servers; ++i )
+  {
+    smproxy::MockEventServerParams serverParam;
+    serverParam.eventSize_ = 10000;
+    serverParam.eventSizeSpread_ = 5000;
+    serverParam.maxEventRate_ = 200;
+    serverParam.seed_ = params.seed + i;
+    servers.push_back( MockEventServerPtr(new smproxy::MockEventServer(serverParam)) );
+    servers.back()->start();
+    // Restarted servers shall listen to the same port
+    serverParam.port_ = servers.back()->port();
+    serverParams.push_back(serverParam);
+    smRegistrationList.push_back(servers.back()->sourceURL());
+  }
+
+  smproxy::StateMachinePtr stateMachine(
+    new smproxy::StateMachine(mockapps::getMockXdaqApplication())
+  );
+  xdata::InfoSpace* infoSpace =
+    mockapps::getMockXdaqApplication()->getApplicationInfoSpace();
+  *dynamic_cast<xdata::Vector<xdata::String>*>(infoSpace->find("SMRegistrationList")) =
+    smRegistrationList;
+
+  Watchdog watchdog;
+  LatencyStats enableStats, stopStats, joinStats;
+  std::vector<size_t> threadCounts;
+  std::vector<size_t> memoryUsage;
+  bool failed = false;
+
+  if ( transition(stateMachine, watchdog, params, smproxy::Configure(), "Ready") < 0 )
+    return 1;
+
+  for ( unsigned int cycle = 0; cycle < params.cycles && ! failed; ++cycle )
+  {
+    const double enableLatency =
+      transition(stateMachine, watchdog, params, smproxy::Enable(), "Enabled");
+    if ( enableLatency < 0 ) { failed = true; break; }
+    enableStats.add(enableLatency);
+
+    volatile bool stopRegistrations = false;
+    boost::thread_group registrationThreads;
+    for ( unsigned int i = 0; i < params.registrationThreads; ++i )
+    {
+      registrationThreads.create_thread(
+        boost::bind(&registerConsumers, stateMachine,
+          params.seed * 1000 + cycle * 100 + i, &stopRegistrations)
+      );
+    }
+
+    injectFailures(servers, serverParams, random, params.enabledMilliseconds);
+
+    // Stop the proxy while the consumers are still registering
+    const double stopLatency =
+      transition(stateMachine, watchdog, params, smproxy::Stop(), "Ready");
+
+    watchdog.arm("Joining the registration threads", params.transitionTimeout);
+    const stor::utils::TimePoint_t joinStart = stor::utils::getCurrentTime();
+    stopRegistrations = true;
+    registrationThreads.join_all();
+    joinStats.add( stor::utils::durationToSeconds(stor::utils::getCurrentTime() - joinStart) );
+    watchdog.disarm();
+
+    if ( stopLatency < 0 ) { failed = true; break; }
+    stopStats.add(stopLatency);
+
+    threadCounts.push_back(threadCount());
+    memoryUsage.push_back(residentMemoryMB());
+    std::cout << "Cycle " << cycle << ": " << threadCounts.back() << " threads, "
+      << memoryUsage.back() << " MB resident" << std::endl;
+  }
+
+  if ( ! failed )
+    failed = ( transition(stateMachine, watchdog, params, smproxy::Halt(), "Halted") < 0 );
+
+  for ( MockEventServers::const_iterator it = servers.begin(), itEnd = servers.end();
+        it != itEnd; ++it )
+    (*it)->stop();
+
+  enableStats.print("Enable");
+  stopStats.print("Stop");
+  joinStats.print("Registration thread join");
+
+  // The first cycles allocate the caches and pools. Look for growth after them.
+  if ( threadCounts.size() > 2 )
+  {
+    const size_t threadGrowth = threadCounts.back() - std::min(threadCounts.back(), threadCounts[1]);
+    const size_t memoryGrowth = memoryUsage.back() - std::min(memoryUsage.back(), memoryUsage[1]);
+    if ( threadGrowth > params.maxThreadGrowth )
+    {
+      std::cerr << "Thread leak: " << threadGrowth << " more threads than after cycle 1" << std::endl;
+      failed = true;
+    }
+    if ( memoryGrowth > params.maxMemoryGrowthMB )
+    {
+      std::cerr << "Memory leak: " << memoryGrowth << " MB more than after cycle 1" << std::endl;
+      failed = true;
+    }
+  }
+
+  std::cout << ( failed ? "FAILED" : "PASSED" ) << std::endl;
+  return failed ? 1 : 0;
+}
+
+
+/// emacs configuration
+/// Local Variables: -
+/// mode: c++ -
+/// c-basic-offset: 2 -
+/// indent-tabs-mode: nil -
+/// End: -
@@ -0,0 +1,347 @@
+// $Id$
+/// @file: smpsThroughputBenchmark.cpp
+//
+// End-to-end throughput benchmark of the SMProxyServer data path.
+// Forks a number of MockEventServer processes, configures and enables
+// an SMProxyServer state machine against them and drains the events
+// with local consumers. Reports the event and byte rates, the CPU time
+// spent per event and the latency percentiles between the creation of
+// an event in the mock server and its delivery to a consumer.
+
+#include "EventFilter/SMProxyServer/interface/StateMachine.h"
+#include "EventFilter/SMProxyServer/test/MockEventServer.h"
+#include "EventFilter/StorageManager/interface/EventConsumerRegistrationInfo.h"
+#include "EventFilter/StorageManager/test/MockApplication.h"
+#include "IOPool/Streamer/interface/EventMessage.h"
+
+#include "xdata/InfoSpace.h"
+#include "xdata/String.h"
+#include "xdata/Vector.h"
+
+#include <boost/bind.hpp>
+#include <boost/thread/thread.hpp>
+
+#include <algorithm>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <sys/resource.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+
+namespace
+{
+  struct BenchmarkParams
+  {
+    unsigned int servers;
+    unsigned int consumers;
+    unsigned int warmupSeconds;
+    unsigned int durationSeconds;
+    smproxy::MockEventServerParams serverParams;
+
+    BenchmarkParams() :
+    servers(2), consumers(4), warmupSeconds(5), durationSeconds(30) {}
+  };
+
+
+  struct ConsumerResult
+  {
+    uint64_t events;
+    uint64_t bytes;
+    std::vector<uint32_t> latencies; // microseconds
+
+    ConsumerResult() : events(0), bytes(0) {}
+  };
+
+
+  void usage(const char* name)
+  {
+    std::cerr << "Usage: " << name << " [options]\n"
+      << "  -N count   number of mock event servers (default: 2)\n"
+      << "  -C count   number of consumers (default: 4)\n"
+      << "  -W s       warm-up time (default: 5)\n"
+      << "  -T s       measurement time (default: 30)\n"
+      << "  -s bytes   mean event size (default: 100000)\n"
+      << "  -w bytes   event size spread (default: 0)\n"
+      << "  -r Hz      maximum event rate per server (default: unlimited)\n"
+      << "  -n count   number of HLT paths (default: 64)\n"
+      << std::endl;
+  }
+
+
+  pid_t startServer(const smproxy::MockEventServerParams& params, std::string& sourceURL)
+  {
+    int fds[2];
+    if ( pipe(fds) != 0 ) { perror("pipe"); exit(1); }
+
+    const pid_t pid = fork();
+    if ( pid < 0 ) { perror("fork"); exit(1); }
+
+    if ( pid == 0 )
+    {
+      close(fds[0]);
+      smproxy::MockEventServer server(params);
+      server.start();
+      const unsigned short port = server.port();
+      if ( write(fds[1], &port, sizeof(port)) != sizeof(port) ) _exit(1);
+      close(fds[1]);
+      pause(); // until the benchmark terminates us
+      _exit(0);
+    }
+
+    close(fds[1]);
+    unsigned short port = 0;
+    if ( read(fds[0], &port, sizeof(port)) != sizeof(port) )
+    {
+      std::cerr << "Mock event server failed to start" << std::endl;
+      exit(1);
+    }
+    close(fds[0]);
+
+    std::ostringstream url;
+    url << "http://localhost:" << port;
+    sourceURL = url.str();
+    return pid;
+  }
+
+
+  stor::EventConsRegPtr registerConsumer
+  (
+    smproxy::StateMachinePtr stateMachine,
+    const std::string& outputModuleLabel,
+    const unsigned int index
+  )
+  {
+    std::ostringstream consumerName;
+    consumerName << "smpsThroughputBenchmark_" << index;
+
+    edm::ParameterSet pset;
+    pset.addUntrackedParameter<std::string>("consumerName", consumerName.str());
+    pset.addUntrackedParameter<std::string>("SelectHLTOutput", outputModuleLabel);
+    pset.addUntrackedParameter<std::string>("TriggerSelector", "");
+    pset.addParameter<std::vector<std::string> >("TrackedEventSelection",
+      std::vector<std::string>());
+    pset.addUntrackedParameter<int>("queueSize", 50);
+    pset.addUntrackedParameter<std::string>("queuePolicy", "DiscardOld");
+    pset.addUntrackedParameter<double>("consumerTimeOut", 600);
+
+    stor::EventConsRegPtr regPtr( new stor::EventConsumerRegistrationInfo(pset,
+        stateMachine->getConfiguration()->getEventServingParams(),
+        "localhost")
+    );
+
+    stor::RegistrationCollectionPtr registrationCollection =
+      stateMachine->getRegistrationCollection();
+
+    const stor::ConsumerID cid = registrationCollection->getConsumerId();
+    regPtr->setConsumerId(cid);
+
+    const stor::QueueID qid =
+      stateMachine->getEventQueueCollection()->createQueue(regPtr);
+    regPtr->setQueueId(qid);
+
+    registrationCollection->addRegistrationInfo(regPtr);
+    stateMachine->getRegistrationQueue()->enqWait(regPtr);
+
+    return regPtr;
+  }
+
+
+  void consume
+  (
+    smproxy::EventQueueCollectionPtr eventQueueCollection,
+    const stor::ConsumerID cid,
+    volatile bool* measuring,
+    volatile bool* done,
+    ConsumerResult* result
+  )
+  {
+    while ( ! *done )
+    {
+      const smproxy::EventQueueCollection::ValueType event =
+        eventQueueCollection->popEvent(cid);
+
+      if ( event.first.empty() )
+      {
+        boost::this_thread::sleep(boost::posix_time::milliseconds(1));
+        continue;
+      }
+      if ( ! *measuring ) continue;
+
+      const uint64_t now = smproxy::MockEventServer::now();
+      const EventMsgView view(event.first.dataLocation());
+      const uint64_t created =
+        smproxy::MockEventServer::getCreationTime(view.eventData());
+
+      ++result->events;
+      result->bytes += event.first.totalDataSize();
+      result->latencies.push_back( now > created ? now - created : 0 );
+    }
+  }
+
+
+  bool transition
+  (
+    smproxy::StateMachinePtr stateMachine,
+    const boost::statechart::event_base& event,
+    const std::string& targetState
+  )
+  {
+    // The state machine does the work of a transition in a separate thread
+    stateMachine->processEvent(event);
+    for ( int i = 0; i < 6000; ++i )
+    {
+      const std::string state = stateMachine->getExternallyVisibleStateName();
+      if ( state == targetState ) return true;
+      if ( state == "Failed" ) break;
+      boost::this_thread::sleep(boost::posix_time::milliseconds(10));
+    }
+    std::cerr << "Failed to reach " << targetState << ": "
+      << stateMachine->getReasonForFailed() << std::endl;
+    return false;
+  }
+
+
+  double cpuSeconds()
+  {
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec +
+      (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+  }
+
+
+  uint32_t percentile(const std::vector<uint32_t>& sorted, const double p)
+  {
+    if ( sorted.empty() ) return 0;
+    const size_t index = static_cast<size_t>(p * (sorted.size() - 1));
+    return sorted[index];
+  }
+}
+
+
+int main(int argc, char* argv[])
+{
+  BenchmarkParams params;
+
+  int opt;
+  while ( (opt = getopt(argc, argv, "N:C:W:T:s:w:r:n:h")) != -1 )
+  {
+    switch (opt)
+    {
+      case 'N': params.servers = atoi(optarg); break;
+      case 'C': params.consumers = atoi(optarg); break;
+      case 'W': params.warmupSeconds = atoi(optarg); break;
+      case 'T': params.durationSeconds = atoi(optarg); break;
+      case 's': params.serverParams.eventSize_ = atol(optarg); break;
+      case 'w': params.serverParams.eventSizeSpread_ = atol(optarg); break;
+      case 'r': params.serverParams.maxEventRate_ = atof(optarg); break;
+      case 'n': params.serverParams.hltPathCount_ = atoi(optarg); break;
+      default: usage(argv[0]); return 1;
+    }
+  }
+
+  // Fork the mock servers before any thread is started
+  std::vector<pid_t> serverPids;
+  xdata::Vector<xdata::String> smRegistrationList;
+  for ( unsigned int i = 0; i < params.servers; ++i )
+  {
+    smproxy::MockEventServerParams serverParams = params.serverParams;
+    serverParams.seed_ += i;
+    std::string sourceURL;
+    serverPids.push_back( startServer(serverParams, sourceURL) );
+    smRegistrationList.push_back(sourceURL);
+  }
+
+  smproxy::StateMachinePtr stateMachine(
+    new smproxy::StateMachine(mockapps::getMockXdaqApplication())
+  );
+  xdata::InfoSpace* infoSpace =
+    mockapps::getMockXdaqApplication()->getApplicationInfoSpace();
+  xdata::Vector<xdata::String>* list = dynamic_cast<xdata::Vector<xdata::String>*>(
+    infoSpace->find("SMRegistrationList"));
+  *list = smRegistrationList;
+
+  if (
+    ! transition(stateMachine, smproxy::Configure(), "Ready") ||
+    ! transition(stateMachine, smproxy::Enable(), "Enabled")
+  )
+    return 1;
+
+  volatile bool measuring = false;
+  volatile bool done = false;
+  std::vector<ConsumerResult> results(params.consumers);
+  boost::thread_group consumerThreads;
+  for ( unsigned int i = 0; i < params.consumers; ++i )
+  {
+    stor::EventConsRegPtr regPtr = registerConsumer(stateMachine,
+      params.serverParams.outputModuleLabel_, i);
+    consumerThreads.create_thread(
+      boost::bind(&consume, stateMachine->getEventQueueCollection(),
+        regPtr->consumerId(), &measuring, &done, &results[i])
+    );
+  }
+
+  sleep(params.warmupSeconds);
+
+  const double cpuStart = cpuSeconds();
+  const uint64_t wallStart = smproxy::MockEventServer::now();
+  measuring = true;
+  sleep(params.durationSeconds);
+  measuring = false;
+  const double cpuUsed = cpuSeconds() - cpuStart;
+  const double wallUsed = (smproxy::MockEventServer::now() - wallStart) / 1e6;
+
+  done = true;
+  consumerThreads.join_all();
+
+  transition(stateMachine, smproxy::Stop(), "Ready");
+  transition(stateMachine, smproxy::Halt(), "Halted");
+
+  for ( std::vector<pid_t>::const_iterator it = serverPids.begin(),
+          itEnd = serverPids.end(); it != itEnd; ++it )
+  {
+    kill(*it, SIGTERM);
+    waitpid(*it, 0, 0);
+  }
+
+  uint64_t events = 0;
+  uint64_t bytes = 0;
+  std::vector<uint32_t> latencies;
+  for ( std::vector<ConsumerResult>::const_iterator it = results.begin(),
+          itEnd = results.end(); it != itEnd; ++it )
+  {
+    events += it->events;
+    bytes += it->bytes;
+    latencies.insert(latencies.end(), it->latencies.begin(), it->latencies.end());
+  }
+  std::sort(latencies.begin(), latencies.end());
+
+  std::cout << std::fixed << std::setprecision(2)
+    << "Servers:            " << params.servers << "\n"
+    << "Consumers:          " << params.consumers << "\n"
+    << "Delivered events:   " << events << "\n"
+    << "Event rate:         " << events / wallUsed << " events/s\n"
+    << "Bandwidth:          " << bytes / wallUsed / 0x100000 << " MB/s\n"
+    << "CPU per event:      "
+    << ( events > 0 ? cpuUsed / events * 1e6 : 0 ) << " us\n"
+    << "Latency p50:        " << percentile(latencies, 0.50) / 1e3 << " ms\n"
+    << "Latency p99:        " << percentile(latencies, 0.99) / 1e3 << " ms"
+    << std::endl;
+
+  return 0;
+}
+
+
+/// emacs configuration
+/// Local Variables: -
+/// mode: c++ -
+/// c-basic-offset: 2 -
+/// indent-tabs-mode: nil -
+/// End: -